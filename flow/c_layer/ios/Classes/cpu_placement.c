@@ -0,0 +1,3 @@
+// Relative import to be able to reuse the C sources.
+// See the comment in ../c_layer.podspec for more information.
+#include "../../src/cpu_placement.c"
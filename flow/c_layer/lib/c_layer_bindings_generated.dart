@@ -31,20 +31,22 @@ class CLayerBindings {
     frame_callback frame_callback,
     int width,
     int height,
+    int num_threads,
   ) {
     return _initialize(
       frame_callback,
       width,
       height,
+      num_threads,
     );
   }
 
   late final _initializePtr = _lookup<
       ffi.NativeFunction<
-          ffi.Void Function(
-              frame_callback, ffi.Uint64, ffi.Uint64)>>('initialize');
-  late final _initialize =
-      _initializePtr.asFunction<void Function(frame_callback, int, int)>();
+          ffi.Void Function(frame_callback, ffi.Uint64, ffi.Uint64,
+              ffi.Uint32)>>('initialize');
+  late final _initialize = _initializePtr
+      .asFunction<void Function(frame_callback, int, int, int)>();
 
   void update_background_color(
     int increment,
@@ -60,6 +62,7 @@ class CLayerBindings {
   late final _update_background_color =
       _update_background_colorPtr.asFunction<void Function(int)>();
 
+  /// Sizes above max_background_size are ignored, the background keeps the size it had.
   void update_background_size(
     int width,
     int height,
@@ -97,7 +100,8 @@ class CLayerBindings {
   late final _update_background_config =
       _update_background_configPtr.asFunction<void Function(int)>();
 
-  void draw_background(
+  /// Returns a draw_status, only draw_started is followed by a frame.
+  int draw_background(
     int cycle_time,
     int x_offset,
     int y_offset,
@@ -111,206 +115,1984 @@ class CLayerBindings {
 
   late final _draw_backgroundPtr = _lookup<
           ffi
-          .NativeFunction<ffi.Void Function(ffi.Uint64, ffi.Int64, ffi.Int64)>>(
+          .NativeFunction<ffi.Uint8 Function(ffi.Uint64, ffi.Int64, ffi.Int64)>>(
       'draw_background');
   late final _draw_background =
-      _draw_backgroundPtr.asFunction<void Function(int, int, int)>();
+      _draw_backgroundPtr.asFunction<int Function(int, int, int)>();
 
-  void image_thread_entry_point(
-    ffi.Pointer<image_settings> settings,
+  /// Applies every command of a command_stream_version stream in order, then renders once from the newest request.
+  /// Nothing is rendered without a command_draw unless the size or background changed and a request was made before.
+  /// Returns a draw_status, draw_rejected when any of the stream is malformed, out of memory or sized above max_background_size,
+  /// none of it is applied then.
+  int submit_commands(
+    ffi.Pointer<ffi.Uint8> buffer,
+    int length,
   ) {
-    return _image_thread_entry_point(
-      settings,
+    return _submit_commands(
+      buffer,
+      length,
     );
   }
 
-  late final _image_thread_entry_pointPtr = _lookup<
-          ffi.NativeFunction<ffi.Void Function(ffi.Pointer<image_settings>)>>(
-      'image_thread_entry_point');
-  late final _image_thread_entry_point = _image_thread_entry_pointPtr
-      .asFunction<void Function(ffi.Pointer<image_settings>)>();
+  late final _submit_commandsPtr = _lookup<
+          ffi
+          .NativeFunction<ffi.Uint8 Function(ffi.Pointer<ffi.Uint8>, ffi.Size)>>(
+      'submit_commands');
+  late final _submit_commands = _submit_commandsPtr
+      .asFunction<int Function(ffi.Pointer<ffi.Uint8>, int)>();
 
-  void grid_configuration(
-    ffi.Pointer<image_settings> settings,
+  void shutdown() {
+    return _shutdown();
+  }
+
+  late final _shutdownPtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function()>>('shutdown');
+  late final _shutdown = _shutdownPtr.asFunction<void Function()>();
+
+  /// Switches the pixel kernels once the frame in flight is done, returns the kernel_isa actually in use.
+  int select_kernels(
+    int isa_byte,
   ) {
-    return _grid_configuration(
-      settings,
+    return _select_kernels(
+      isa_byte,
     );
   }
 
-  late final _grid_configurationPtr = _lookup<
-          ffi.NativeFunction<ffi.Void Function(ffi.Pointer<image_settings>)>>(
-      'grid_configuration');
-  late final _grid_configuration = _grid_configurationPtr
-      .asFunction<void Function(ffi.Pointer<image_settings>)>();
+  late final _select_kernelsPtr =
+      _lookup<ffi.NativeFunction<ffi.Uint8 Function(ffi.Uint8)>>(
+          'select_kernels');
+  late final _select_kernels =
+      _select_kernelsPtr.asFunction<int Function(int)>();
 
-  void wave_configuration(
-    ffi.Pointer<image_settings> settings,
+  void set_render_mode(
+    int mode_byte,
   ) {
-    return _wave_configuration(
-      settings,
+    return _set_render_mode(
+      mode_byte,
     );
   }
 
-  late final _wave_configurationPtr = _lookup<
-          ffi.NativeFunction<ffi.Void Function(ffi.Pointer<image_settings>)>>(
-      'wave_configuration');
-  late final _wave_configuration = _wave_configurationPtr
-      .asFunction<void Function(ffi.Pointer<image_settings>)>();
+  late final _set_render_modePtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function(ffi.Uint8)>>(
+          'set_render_mode');
+  late final _set_render_mode =
+      _set_render_modePtr.asFunction<void Function(int)>();
 
-  bool is_index_in_range(
-    int index,
-    double base,
-    range range,
+  void release_frame(
+    int frame_id,
   ) {
-    return _is_index_in_range(
-      index,
-      base,
-      range,
+    return _release_frame(
+      frame_id,
     );
   }
 
-  late final _is_index_in_rangePtr = _lookup<
-          ffi.NativeFunction<ffi.Bool Function(ffi.Int, ffi.Double, range)>>(
-      'is_index_in_range');
-  late final _is_index_in_range =
-      _is_index_in_rangePtr.asFunction<bool Function(int, double, range)>();
+  late final _release_framePtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function(ffi.Uint64)>>(
+          'release_frame');
+  late final _release_frame =
+      _release_framePtr.asFunction<void Function(int)>();
 
-  int round_double_to_int(
-    double x,
+  void set_incremental_rendering(
+    int enabled,
   ) {
-    return _round_double_to_int(
-      x,
+    return _set_incremental_rendering(
+      enabled,
     );
   }
 
-  late final _round_double_to_intPtr =
-      _lookup<ffi.NativeFunction<ffi.Int Function(ffi.Double)>>(
-          'round_double_to_int');
-  late final _round_double_to_int =
-      _round_double_to_intPtr.asFunction<int Function(double)>();
-}
+  late final _set_incremental_renderingPtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function(ffi.Uint8)>>(
+          'set_incremental_rendering');
+  late final _set_incremental_rendering =
+      _set_incremental_renderingPtr.asFunction<void Function(int)>();
 
-abstract class configuration {
-  static const int grid = 0;
-  static const int wave = 1;
-}
+  /// Renders only the strips of frames that are exactly the previous one shifted, the consumer draws its previous frame shifted under them.
+  void set_strip_rendering(
+    int enabled,
+  ) {
+    return _set_strip_rendering(
+      enabled,
+    );
+  }
 
-final class range extends ffi.Struct {
-  @ffi.Double()
-  external double offset;
+  late final _set_strip_renderingPtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function(ffi.Uint8)>>(
+          'set_strip_rendering');
+  late final _set_strip_rendering =
+      _set_strip_renderingPtr.asFunction<void Function(int)>();
 
-  @ffi.Double()
-  external double tolerance;
-}
+  /// Copies the shift of a held frame relative to the frame presented before it, false when the frame is not held.
+  bool get_frame_shift(
+    int frame_id,
+    ffi.Pointer<frame_shift> shift,
+  ) {
+    return _get_frame_shift(
+      frame_id,
+      shift,
+    );
+  }
 
-final class rgba extends ffi.Struct {
-  @ffi.Uint8()
-  external int r;
+  late final _get_frame_shiftPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Bool Function(ffi.Uint64, ffi.Pointer<frame_shift>)>>('get_frame_shift');
+  late final _get_frame_shift = _get_frame_shiftPtr
+      .asFunction<bool Function(int, ffi.Pointer<frame_shift>)>();
 
-  @ffi.Uint8()
-  external int g;
+  int get_dirty_rects(
+    int frame_id,
+    ffi.Pointer<rect> rects,
+    int capacity,
+  ) {
+    return _get_dirty_rects(
+      frame_id,
+      rects,
+      capacity,
+    );
+  }
 
-  @ffi.Uint8()
-  external int b;
+  late final _get_dirty_rectsPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Uint32 Function(
+              ffi.Uint64, ffi.Pointer<rect>, ffi.Uint32)>>('get_dirty_rects');
+  late final _get_dirty_rects = _get_dirty_rectsPtr
+      .asFunction<int Function(int, ffi.Pointer<rect>, int)>();
 
-  @ffi.Uint8()
-  external int a;
-}
+  /// Hands frames to callback as geometry built on the caller's thread rather than as pixels, NULL goes back to pixels.
+  /// Backgrounds that cannot be described as geometry are not drawn while it is set.
+  void set_geometry_output(
+    geometry_callback callback,
+  ) {
+    return _set_geometry_output(
+      callback,
+    );
+  }
 
-final class colors extends ffi.Struct {
-  external rgba background_color;
+  late final _set_geometry_outputPtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function(geometry_callback)>>(
+          'set_geometry_output');
+  late final _set_geometry_output =
+      _set_geometry_outputPtr.asFunction<void Function(geometry_callback)>();
 
-  external rgba line_color;
+  /// Draws num_entities entities over every following pixel frame, clipped to every tile by the worker rendering it, until the next call.
+  /// Frames with entities are never cached and geometry frames never have them. Returns false when memory ran out, the previous entities are then kept.
+  bool set_entities(
+    ffi.Pointer<entity> entities,
+    int num_entities,
+  ) {
+    return _set_entities(
+      entities,
+      num_entities,
+    );
+  }
 
-  external rgba widget_color;
-}
+  late final _set_entitiesPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Bool Function(ffi.Pointer<entity>, ffi.Uint32)>>('set_entities');
+  late final _set_entities = _set_entitiesPtr
+      .asFunction<bool Function(ffi.Pointer<entity>, int)>();
 
-final class image_settings extends ffi.Struct {
-  @ffi.Int32()
-  external int config;
+  bool get_frame_indices(
+    int frame_id,
+    ffi.Pointer<index_plane> plane,
+  ) {
+    return _get_frame_indices(
+      frame_id,
+      plane,
+    );
+  }
 
-  @ffi.Uint64()
-  external int cycle_time;
+  late final _get_frame_indicesPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Bool Function(
+              ffi.Uint64, ffi.Pointer<index_plane>)>>('get_frame_indices');
+  late final _get_frame_indices = _get_frame_indicesPtr
+      .asFunction<bool Function(int, ffi.Pointer<index_plane>)>();
 
-  @ffi.Uint64()
-  external int x_offset;
+  framebuffer_memory get_framebuffer_memory() {
+    return _get_framebuffer_memory();
+  }
 
-  @ffi.Uint64()
-  external int y_offset;
+  late final _get_framebuffer_memoryPtr =
+      _lookup<ffi.NativeFunction<framebuffer_memory Function()>>(
+          'get_framebuffer_memory');
+  late final _get_framebuffer_memory =
+      _get_framebuffer_memoryPtr.asFunction<framebuffer_memory Function()>();
 
-  @ffi.Uint64()
-  external int start_row;
+  /// Copies the stats of up to capacity of the most recently presented frames, oldest first, and returns how many were copied.
+  int get_frame_stats(
+    ffi.Pointer<frame_stats> stats,
+    int capacity,
+  ) {
+    return _get_frame_stats(
+      stats,
+      capacity,
+    );
+  }
 
-  @ffi.Uint64()
-  external int end_row;
-}
+  late final _get_frame_statsPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Uint32 Function(
+              ffi.Pointer<frame_stats>, ffi.Uint32)>>('get_frame_stats');
+  late final _get_frame_stats = _get_frame_statsPtr
+      .asFunction<int Function(ffi.Pointer<frame_stats>, int)>();
 
-final class image_thread extends ffi.Struct {
-  external image_settings settings;
+  void set_render_scale(
+    int scale_byte,
+  ) {
+    return _set_render_scale(
+      scale_byte,
+    );
+  }
 
-  external thrd_t thread;
-}
+  late final _set_render_scalePtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function(ffi.Uint8)>>(
+          'set_render_scale');
+  late final _set_render_scale =
+      _set_render_scalePtr.asFunction<void Function(int)>();
 
-final class thrd_t extends ffi.Struct {
-  external ffi.Pointer<ffi.Void> _Handle;
+  int get_render_scale() {
+    return _get_render_scale();
+  }
 
-  @ffi.Uint32()
-  external int _Tid;
-}
+  late final _get_render_scalePtr =
+      _lookup<ffi.NativeFunction<ffi.Uint8 Function()>>('get_render_scale');
+  late final _get_render_scale =
+      _get_render_scalePtr.asFunction<int Function()>();
 
-final class image extends ffi.Struct {
-  @ffi.Uint64()
-  external int width;
+  /// Renders up to ratio output pixels per logical pixel, 1 keeps frames at the logical size, ratios above max_device_pixel_ratio are capped.
+  void set_device_pixel_ratio(
+    double ratio,
+  ) {
+    return _set_device_pixel_ratio(
+      ratio,
+    );
+  }
 
-  @ffi.Uint64()
-  external int height;
+  late final _set_device_pixel_ratioPtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function(ffi.Double)>>(
+          'set_device_pixel_ratio');
+  late final _set_device_pixel_ratio =
+      _set_device_pixel_ratioPtr.asFunction<void Function(double)>();
 
-  @ffi.Int32()
-  external int config;
+  /// Lets the render scale follow the time frames take to render, 0 keeps it where set_render_scale put it.
+  void set_frame_budget(
+    double milliseconds,
+  ) {
+    return _set_frame_budget(
+      milliseconds,
+    );
+  }
 
-  external ffi.Pointer<rgba> pixels;
-}
+  late final _set_frame_budgetPtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function(ffi.Double)>>(
+          'set_frame_budget');
+  late final _set_frame_budget =
+      _set_frame_budgetPtr.asFunction<void Function(double)>();
 
-final class context extends ffi.Struct {
-  external frame_callback frame_callback1;
+  /// CPUs the process can actually use, bounded by its affinity and its cgroup CPU quota where there is one.
+  int detect_core_count() {
+    return _detect_core_count();
+  }
 
-  external colors colors1;
+  late final _detect_core_countPtr =
+      _lookup<ffi.NativeFunction<ffi.Uint32 Function()>>('detect_core_count');
+  late final _detect_core_count =
+      _detect_core_countPtr.asFunction<int Function()>();
 
-  external image background;
+  /// Moves every render worker to placement and returns how many took all of it, workers started by initialize begin with the defaults.
+  int set_worker_placement(
+    ffi.Pointer<worker_placement> placement,
+  ) {
+    return _set_worker_placement(
+      placement,
+    );
+  }
 
-  @ffi.Uint8()
-  external int num_image_threads;
+  late final _set_worker_placementPtr = _lookup<
+          ffi.NativeFunction<ffi.Uint32 Function(ffi.Pointer<worker_placement>)>>(
+      'set_worker_placement');
+  late final _set_worker_placement = _set_worker_placementPtr
+      .asFunction<int Function(ffi.Pointer<worker_placement>)>();
 
-  external ffi.Pointer<image_thread> image_threads;
+  /// Copies what up to capacity workers ended up with after set_worker_placement, and returns how many were copied.
+  int get_worker_placement(
+    ffi.Pointer<worker_placement_status> status,
+    int capacity,
+  ) {
+    return _get_worker_placement(
+      status,
+      capacity,
+    );
+  }
 
-  external mtx_t mutex;
-}
+  late final _get_worker_placementPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Uint32 Function(ffi.Pointer<worker_placement_status>,
+              ffi.Uint32)>>('get_worker_placement');
+  late final _get_worker_placement = _get_worker_placementPtr.asFunction<
+      int Function(ffi.Pointer<worker_placement_status>, int)>();
 
-typedef frame_callback
-    = ffi.Pointer<ffi.NativeFunction<frame_callbackFunction>>;
-typedef frame_callbackFunction = ffi.Void Function(ffi.Uint64 width,
-    ffi.Uint64 height, ffi.Uint64 data_size, ffi.Pointer<ffi.Void> data);
-typedef Dartframe_callbackFunction = void Function(
-    int width, int height, int data_size, ffi.Pointer<ffi.Void> data);
+  /// Samples hardware counters around every tile into the worker timings of get_frame_stats, 0 turns them off.
+  /// Returns the mask of perf_counter bits this system permits, zero where there are none, as off Linux.
+  int set_perf_counters(
+    int enabled,
+  ) {
+    return _set_perf_counters(
+      enabled,
+    );
+  }
 
-final class mtx_t extends ffi.Struct {
-  @ffi.UintPtr()
-  external int _Type;
+  late final _set_perf_countersPtr =
+      _lookup<ffi.NativeFunction<ffi.Uint32 Function(ffi.Uint8)>>(
+          'set_perf_counters');
+  late final _set_perf_counters =
+      _set_perf_countersPtr.asFunction<int Function(int)>();
 
-  external ffi.Pointer<ffi.Void> _Ptr;
+  /// Frames are kept by everything they were rendered from, and shown again by copying them rather than rendering them.
+  void set_frame_cache(
+    ffi.Pointer<frame_cache_settings> settings,
+  ) {
+    return _set_frame_cache(
+      settings,
+    );
+  }
 
-  external ffi.Pointer<ffi.Void> _Cv;
+  late final _set_frame_cachePtr = _lookup<
+          ffi.NativeFunction<ffi.Void Function(ffi.Pointer<frame_cache_settings>)>>(
+      'set_frame_cache');
+  late final _set_frame_cache = _set_frame_cachePtr
+      .asFunction<void Function(ffi.Pointer<frame_cache_settings>)>();
 
-  @ffi.Uint32()
-  external int _Owner;
+  /// Renders num_frames frames into the cache, from cycle_time one time_quantum apart, with the current background, size and colors.
+  /// Frames are rendered one at a time when a draw_background call has nothing else for the workers, a new call replaces what is left.
+  /// Returns how many of the frames were not cached yet.
+  int warm_frame_cache(
+    int cycle_time,
+    int num_frames,
+    int x_offset,
+    int y_offset,
+  ) {
+    return _warm_frame_cache(
+      cycle_time,
+      num_frames,
+      x_offset,
+      y_offset,
+    );
+  }
 
-  @ffi.Uint32()
-  external int _Cnt;
-}
+  late final _warm_frame_cachePtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Uint32 Function(ffi.Uint64, ffi.Uint32, ffi.Int64,
+              ffi.Int64)>>('warm_frame_cache');
+  late final _warm_frame_cache =
+      _warm_frame_cachePtr.asFunction<int Function(int, int, int, int)>();
 
-const int square_size = 150;
+  frame_cache_stats get_frame_cache_stats() {
+    return _get_frame_cache_stats();
+  }
 
-const int square_stroke_thickness = 2;
+  late final _get_frame_cache_statsPtr =
+      _lookup<ffi.NativeFunction<frame_cache_stats Function()>>(
+          'get_frame_cache_stats');
+  late final _get_frame_cache_stats =
+      _get_frame_cache_statsPtr.asFunction<frame_cache_stats Function()>();
 
-const int square_stroke_spacing = 50;
+  /// Starts recording a fresh trace of every thread that renders or hands out frames, 0 stops recording.
+  void set_tracing(
+    int enabled,
+  ) {
+    return _set_tracing(
+      enabled,
+    );
+  }
+
+  late final _set_tracingPtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function(ffi.Uint8)>>('set_tracing');
+  late final _set_tracing = _set_tracingPtr.asFunction<void Function(int)>();
+
+  /// Writes what has been recorded as Chrome trace JSON, which chrome://tracing and Perfetto open.
+  bool write_trace(
+    ffi.Pointer<ffi.Char> path,
+  ) {
+    return _write_trace(
+      path,
+    );
+  }
+
+  late final _write_tracePtr =
+      _lookup<ffi.NativeFunction<ffi.Bool Function(ffi.Pointer<ffi.Char>)>>(
+          'write_trace');
+  late final _write_trace =
+      _write_tracePtr.asFunction<bool Function(ffi.Pointer<ffi.Char>)>();
+
+  /// The clock trace events are timed with, so events recorded outside of the library line up with it.
+  int trace_clock() {
+    return _trace_clock();
+  }
+
+  late final _trace_clockPtr =
+      _lookup<ffi.NativeFunction<ffi.Uint64 Function()>>('trace_clock');
+  late final _trace_clock = _trace_clockPtr.asFunction<int Function()>();
+
+  /// Records an event timed with trace_clock on a track of its own, name has to stay valid until the trace is written.
+  void trace_dart_event(
+    ffi.Pointer<ffi.Char> name,
+    int start_nanoseconds,
+    int end_nanoseconds,
+  ) {
+    return _trace_dart_event(
+      name,
+      start_nanoseconds,
+      end_nanoseconds,
+    );
+  }
+
+  late final _trace_dart_eventPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Void Function(ffi.Pointer<ffi.Char>, ffi.Uint64,
+              ffi.Uint64)>>('trace_dart_event');
+  late final _trace_dart_event = _trace_dart_eventPtr
+      .asFunction<void Function(ffi.Pointer<ffi.Char>, int, int)>();
+
+  int render_background(
+    int cycle_time,
+    int x_offset,
+    int y_offset,
+  ) {
+    return _render_background(
+      cycle_time,
+      x_offset,
+      y_offset,
+    );
+  }
+
+  late final _render_backgroundPtr = _lookup<
+          ffi
+          .NativeFunction<ffi.Int32 Function(ffi.Uint64, ffi.Int64, ffi.Int64)>>(
+      'render_background');
+  late final _render_background =
+      _render_backgroundPtr.asFunction<int Function(int, int, int)>();
+
+  /// False when the stream is malformed or its entities do not fit in memory, the context is left as it was.
+  bool stage_commands(
+    ffi.Pointer<ffi.Uint8> buffer,
+    int length,
+    ffi.Pointer<command_batch> batch,
+  ) {
+    return _stage_commands(
+      buffer,
+      length,
+      batch,
+    );
+  }
+
+  late final _stage_commandsPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Bool Function(ffi.Pointer<ffi.Uint8>, ffi.Size,
+              ffi.Pointer<command_batch>)>>('stage_commands');
+  late final _stage_commands = _stage_commandsPtr.asFunction<
+      bool Function(ffi.Pointer<ffi.Uint8>, int, ffi.Pointer<command_batch>)>();
+
+  int apply_commands(
+    ffi.Pointer<command_batch> batch,
+  ) {
+    return _apply_commands(
+      batch,
+    );
+  }
+
+  late final _apply_commandsPtr = _lookup<
+          ffi.NativeFunction<ffi.Int32 Function(ffi.Pointer<command_batch>)>>(
+      'apply_commands');
+  late final _apply_commands = _apply_commandsPtr
+      .asFunction<int Function(ffi.Pointer<command_batch>)>();
+
+  rgba step_background_color(
+    rgba color,
+    int increment,
+  ) {
+    return _step_background_color(
+      color,
+      increment,
+    );
+  }
+
+  late final _step_background_colorPtr =
+      _lookup<ffi.NativeFunction<rgba Function(rgba, ffi.Int)>>(
+          'step_background_color');
+  late final _step_background_color =
+      _step_background_colorPtr.asFunction<rgba Function(rgba, int)>();
+
+  bool reserve_entities(
+    int num_entities,
+  ) {
+    return _reserve_entities(
+      num_entities,
+    );
+  }
+
+  late final _reserve_entitiesPtr =
+      _lookup<ffi.NativeFunction<ffi.Bool Function(ffi.Uint32)>>(
+          'reserve_entities');
+  late final _reserve_entities =
+      _reserve_entitiesPtr.asFunction<bool Function(int)>();
+
+  void create_context_mutex() {
+    return _create_context_mutex();
+  }
+
+  late final _create_context_mutexPtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function()>>('create_context_mutex');
+  late final _create_context_mutex =
+      _create_context_mutexPtr.asFunction<void Function()>();
+
+  void lock_context() {
+    return _lock_context();
+  }
+
+  late final _lock_contextPtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function()>>('lock_context');
+  late final _lock_context = _lock_contextPtr.asFunction<void Function()>();
+
+  void unlock_context() {
+    return _unlock_context();
+  }
+
+  late final _unlock_contextPtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function()>>('unlock_context');
+  late final _unlock_context = _unlock_contextPtr.asFunction<void Function()>();
+
+  int render_latest_request() {
+    return _render_latest_request();
+  }
+
+  late final _render_latest_requestPtr =
+      _lookup<ffi.NativeFunction<ffi.Int32 Function()>>('render_latest_request');
+  late final _render_latest_request =
+      _render_latest_requestPtr.asFunction<int Function()>();
+
+  int render_geometry(
+    ffi.Pointer<render_request> request,
+    frame_inputs inputs,
+  ) {
+    return _render_geometry(
+      request,
+      inputs,
+    );
+  }
+
+  late final _render_geometryPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Int32 Function(
+              ffi.Pointer<render_request>, frame_inputs)>>('render_geometry');
+  late final _render_geometry = _render_geometryPtr
+      .asFunction<int Function(ffi.Pointer<render_request>, frame_inputs)>();
+
+  frame_inputs request_inputs(
+    ffi.Pointer<render_request> request,
+  ) {
+    return _request_inputs(
+      request,
+    );
+  }
+
+  late final _request_inputsPtr = _lookup<
+          ffi.NativeFunction<frame_inputs Function(ffi.Pointer<render_request>)>>(
+      'request_inputs');
+  late final _request_inputs = _request_inputsPtr
+      .asFunction<frame_inputs Function(ffi.Pointer<render_request>)>();
+
+  int cycle_phase(
+    int cycle_time,
+  ) {
+    return _cycle_phase(
+      cycle_time,
+    );
+  }
+
+  late final _cycle_phasePtr =
+      _lookup<ffi.NativeFunction<ffi.Uint64 Function(ffi.Uint64)>>(
+          'cycle_phase');
+  late final _cycle_phase = _cycle_phasePtr.asFunction<int Function(int)>();
+
+  void take_finished_frame() {
+    return _take_finished_frame();
+  }
+
+  late final _take_finished_framePtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function()>>('take_finished_frame');
+  late final _take_finished_frame =
+      _take_finished_framePtr.asFunction<void Function()>();
+
+  bool show_cached_frame(
+    ffi.Pointer<framebuffer> framebuffer,
+    ffi.Pointer<render_request> request,
+    frame_inputs inputs,
+  ) {
+    return _show_cached_frame(
+      framebuffer,
+      request,
+      inputs,
+    );
+  }
+
+  late final _show_cached_framePtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Bool Function(ffi.Pointer<framebuffer>,
+              ffi.Pointer<render_request>, frame_inputs)>>('show_cached_frame');
+  late final _show_cached_frame = _show_cached_framePtr.asFunction<
+      bool Function(
+          ffi.Pointer<framebuffer>, ffi.Pointer<render_request>, frame_inputs)>();
+
+  void warm_next_frame() {
+    return _warm_next_frame();
+  }
+
+  late final _warm_next_framePtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function()>>('warm_next_frame');
+  late final _warm_next_frame =
+      _warm_next_framePtr.asFunction<void Function()>();
+
+  void compute_frame_shift(
+    ffi.Pointer<framebuffer> framebuffer,
+  ) {
+    return _compute_frame_shift(
+      framebuffer,
+    );
+  }
+
+  late final _compute_frame_shiftPtr = _lookup<
+          ffi.NativeFunction<ffi.Void Function(ffi.Pointer<framebuffer>)>>(
+      'compute_frame_shift');
+  late final _compute_frame_shift = _compute_frame_shiftPtr
+      .asFunction<void Function(ffi.Pointer<framebuffer>)>();
+
+  void strip_columns(
+    ffi.Pointer<image_settings> settings,
+    int y,
+    ffi.Pointer<ffi.Uint64> start,
+    ffi.Pointer<ffi.Uint64> end,
+  ) {
+    return _strip_columns(
+      settings,
+      y,
+      start,
+      end,
+    );
+  }
+
+  late final _strip_columnsPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Void Function(ffi.Pointer<image_settings>, ffi.Uint64,
+              ffi.Pointer<ffi.Uint64>, ffi.Pointer<ffi.Uint64>)>>('strip_columns');
+  late final _strip_columns = _strip_columnsPtr.asFunction<
+      void Function(ffi.Pointer<image_settings>, int, ffi.Pointer<ffi.Uint64>,
+          ffi.Pointer<ffi.Uint64>)>();
+
+  frame_inputs warm_request_inputs() {
+    return _warm_request_inputs();
+  }
+
+  late final _warm_request_inputsPtr =
+      _lookup<ffi.NativeFunction<frame_inputs Function()>>(
+          'warm_request_inputs');
+  late final _warm_request_inputs =
+      _warm_request_inputsPtr.asFunction<frame_inputs Function()>();
+
+  int warm_step() {
+    return _warm_step();
+  }
+
+  late final _warm_stepPtr =
+      _lookup<ffi.NativeFunction<ffi.Uint64 Function()>>('warm_step');
+  late final _warm_step = _warm_stepPtr.asFunction<int Function()>();
+
+  bool prepare_frame(
+    ffi.Pointer<framebuffer> framebuffer,
+    int requested,
+    int cycle_time,
+    int x_offset,
+    int y_offset,
+  ) {
+    return _prepare_frame(
+      framebuffer,
+      requested,
+      cycle_time,
+      x_offset,
+      y_offset,
+    );
+  }
+
+  late final _prepare_framePtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Bool Function(ffi.Pointer<framebuffer>, ffi.Uint64, ffi.Uint64,
+              ffi.Int64, ffi.Int64)>>('prepare_frame');
+  late final _prepare_frame = _prepare_framePtr.asFunction<
+      bool Function(ffi.Pointer<framebuffer>, int, int, int, int)>();
+
+  void present_frame(
+    ffi.Pointer<framebuffer> framebuffer,
+  ) {
+    return _present_frame(
+      framebuffer,
+    );
+  }
+
+  late final _present_framePtr = _lookup<
+          ffi.NativeFunction<ffi.Void Function(ffi.Pointer<framebuffer>)>>(
+      'present_frame');
+  late final _present_frame = _present_framePtr
+      .asFunction<void Function(ffi.Pointer<framebuffer>)>();
+
+  void render_frame_done(
+    ffi.Pointer<ffi.Void> data,
+  ) {
+    return _render_frame_done(
+      data,
+    );
+  }
+
+  late final _render_frame_donePtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function(ffi.Pointer<ffi.Void>)>>(
+          'render_frame_done');
+  late final _render_frame_done = _render_frame_donePtr
+      .asFunction<void Function(ffi.Pointer<ffi.Void>)>();
+
+  void record_render_time(
+    ffi.Pointer<framebuffer> framebuffer,
+  ) {
+    return _record_render_time(
+      framebuffer,
+    );
+  }
+
+  late final _record_render_timePtr = _lookup<
+          ffi.NativeFunction<ffi.Void Function(ffi.Pointer<framebuffer>)>>(
+      'record_render_time');
+  late final _record_render_time = _record_render_timePtr
+      .asFunction<void Function(ffi.Pointer<framebuffer>)>();
+
+  void adapt_render_scale(
+    double milliseconds,
+  ) {
+    return _adapt_render_scale(
+      milliseconds,
+    );
+  }
+
+  late final _adapt_render_scalePtr =
+      _lookup<ffi.NativeFunction<ffi.Void Function(ffi.Double)>>(
+          'adapt_render_scale');
+  late final _adapt_render_scale =
+      _adapt_render_scalePtr.asFunction<void Function(double)>();
+
+  int monotonic_nanoseconds() {
+    return _monotonic_nanoseconds();
+  }
+
+  late final _monotonic_nanosecondsPtr =
+      _lookup<ffi.NativeFunction<ffi.Uint64 Function()>>(
+          'monotonic_nanoseconds');
+  late final _monotonic_nanoseconds =
+      _monotonic_nanosecondsPtr.asFunction<int Function()>();
+
+  void image_job(
+    ffi.Pointer<ffi.Void> data,
+    int worker_index,
+  ) {
+    return _image_job(
+      data,
+      worker_index,
+    );
+  }
+
+  late final _image_jobPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Void Function(ffi.Pointer<ffi.Void>, ffi.Uint32)>>('image_job');
+  late final _image_job =
+      _image_jobPtr.asFunction<void Function(ffi.Pointer<ffi.Void>, int)>();
+
+  void placement_job(
+    ffi.Pointer<ffi.Void> data,
+    int worker_index,
+  ) {
+    return _placement_job(
+      data,
+      worker_index,
+    );
+  }
+
+  late final _placement_jobPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Void Function(ffi.Pointer<ffi.Void>, ffi.Uint32)>>('placement_job');
+  late final _placement_job = _placement_jobPtr
+      .asFunction<void Function(ffi.Pointer<ffi.Void>, int)>();
+
+  void image_thread_entry_point(
+    ffi.Pointer<image_settings> settings,
+  ) {
+    return _image_thread_entry_point(
+      settings,
+    );
+  }
+
+  late final _image_thread_entry_pointPtr = _lookup<
+          ffi.NativeFunction<ffi.Void Function(ffi.Pointer<image_settings>)>>(
+      'image_thread_entry_point');
+  late final _image_thread_entry_point = _image_thread_entry_pointPtr
+      .asFunction<void Function(ffi.Pointer<image_settings>)>();
+
+  void emit_row(
+    ffi.Pointer<image_settings> settings,
+    int y,
+  ) {
+    return _emit_row(
+      settings,
+      y,
+    );
+  }
+
+  late final _emit_rowPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Void Function(
+              ffi.Pointer<image_settings>, ffi.Uint64)>>('emit_row');
+  late final _emit_row = _emit_rowPtr
+      .asFunction<void Function(ffi.Pointer<image_settings>, int)>();
+
+  void emit_scaled_row(
+    ffi.Pointer<image_settings> settings,
+    int y,
+    int first_x,
+    int end_x,
+  ) {
+    return _emit_scaled_row(
+      settings,
+      y,
+      first_x,
+      end_x,
+    );
+  }
+
+  late final _emit_scaled_rowPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Void Function(ffi.Pointer<image_settings>, ffi.Uint64,
+              ffi.Uint64, ffi.Uint64)>>('emit_scaled_row');
+  late final _emit_scaled_row = _emit_scaled_rowPtr.asFunction<
+      void Function(ffi.Pointer<image_settings>, int, int, int)>();
+
+  void fill_row_spans(
+    ffi.Pointer<ffi.Uint8> indices,
+    int width,
+    ffi.Pointer<span> spans,
+    int num_spans,
+  ) {
+    return _fill_row_spans(
+      indices,
+      width,
+      spans,
+      num_spans,
+    );
+  }
+
+  late final _fill_row_spansPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Void Function(ffi.Pointer<ffi.Uint8>, ffi.Uint64,
+              ffi.Pointer<span>, ffi.Int)>>('fill_row_spans');
+  late final _fill_row_spans = _fill_row_spansPtr.asFunction<
+      void Function(ffi.Pointer<ffi.Uint8>, int, ffi.Pointer<span>, int)>();
+
+  /// Rewrites the pixels whose coverage changed since previous and returns how many, extent receives the range they span.
+  int update_row_spans(
+    ffi.Pointer<ffi.Uint8> indices,
+    ffi.Pointer<rgba> row,
+    ffi.Pointer<row_state> previous,
+    ffi.Pointer<span> spans,
+    int num_spans,
+    ffi.Pointer<colors> colors,
+    ffi.Pointer<span> extent,
+  ) {
+    return _update_row_spans(
+      indices,
+      row,
+      previous,
+      spans,
+      num_spans,
+      colors,
+      extent,
+    );
+  }
+
+  late final _update_row_spansPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Uint32 Function(
+              ffi.Pointer<ffi.Uint8>,
+              ffi.Pointer<rgba>,
+              ffi.Pointer<row_state>,
+              ffi.Pointer<span>,
+              ffi.Int,
+              ffi.Pointer<colors>,
+              ffi.Pointer<span>)>>('update_row_spans');
+  late final _update_row_spans = _update_row_spansPtr.asFunction<
+      int Function(
+          ffi.Pointer<ffi.Uint8>,
+          ffi.Pointer<rgba>,
+          ffi.Pointer<row_state>,
+          ffi.Pointer<span>,
+          int,
+          ffi.Pointer<colors>,
+          ffi.Pointer<span>)>();
+
+  void store_row_spans(
+    ffi.Pointer<row_state> state,
+    ffi.Pointer<span> spans,
+    int num_spans,
+  ) {
+    return _store_row_spans(
+      state,
+      spans,
+      num_spans,
+    );
+  }
+
+  late final _store_row_spansPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Void Function(ffi.Pointer<row_state>, ffi.Pointer<span>,
+              ffi.Int)>>('store_row_spans');
+  late final _store_row_spans = _store_row_spansPtr.asFunction<
+      void Function(ffi.Pointer<row_state>, ffi.Pointer<span>, int)>();
+
+  int span_difference(
+    ffi.Pointer<span> a,
+    int num_a,
+    ffi.Pointer<span> b,
+    int num_b,
+    ffi.Pointer<span> difference,
+  ) {
+    return _span_difference(
+      a,
+      num_a,
+      b,
+      num_b,
+      difference,
+    );
+  }
+
+  late final _span_differencePtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Int Function(ffi.Pointer<span>, ffi.Int, ffi.Pointer<span>,
+              ffi.Int, ffi.Pointer<span>)>>('span_difference');
+  late final _span_difference = _span_differencePtr.asFunction<
+      int Function(
+          ffi.Pointer<span>, int, ffi.Pointer<span>, int, ffi.Pointer<span>)>();
+
+  bool spans_cover(
+    ffi.Pointer<span> spans,
+    int num_spans,
+    int x,
+  ) {
+    return _spans_cover(
+      spans,
+      num_spans,
+      x,
+    );
+  }
+
+  late final _spans_coverPtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Bool Function(
+              ffi.Pointer<span>, ffi.Int, ffi.Uint32)>>('spans_cover');
+  late final _spans_cover = _spans_coverPtr
+      .asFunction<bool Function(ffi.Pointer<span>, int, int)>();
+
+  bool row_state_difference(
+    ffi.Pointer<row_state> a,
+    ffi.Pointer<row_state> b,
+    int width,
+    ffi.Pointer<ffi.Uint32> first,
+    ffi.Pointer<ffi.Uint32> end,
+  ) {
+    return _row_state_difference(
+      a,
+      b,
+      width,
+      first,
+      end,
+    );
+  }
+
+  late final _row_state_differencePtr = _lookup<
+      ffi.NativeFunction<
+          ffi.Bool Function(
+              ffi.Pointer<row_state>,
+              ffi.Pointer<row_state>,
+              ffi.Uint64,
+              ffi.Pointer<ffi.Uint32>,
+              ffi.Pointer<ffi.Uint32>)>>('row_state_difference');
+  late final _row_state_difference = _row_state_differencePtr.asFunction<
+      bool Function(ffi.Pointer<row_state>, ffi.Pointer<row_state>, int,
+          ffi.Pointer<ffi.Uint32>, ffi.Pointer<ffi.Uint32>)>();
+
+  void compute_dirty_rects(
+    ffi.Pointer<framebuffer> framebuffer,
+  ) {
+    return _compute_dirty_rects(
+      framebuffer,
+    );
+  }
+
+  late final _compute_dirty_rectsPtr = _lookup<
+          ffi.NativeFunction<ffi.Void Function(ffi.Pointer<framebuffer>)>>(
+      'compute_dirty_rects');
+  late final _compute_dirty_rects = _compute_dirty_rectsPtr
+      .asFunction<void Function(ffi.Pointer<framebuffer>)>();
+
+  bool frame_key_equal(
+    frame_key a,
+    frame_key b,
+  ) {
+    return _frame_key_equal(
+      a,
+      b,
+    );
+  }
+
+  late final _frame_key_equalPtr =
+      _lookup<ffi.NativeFunction<ffi.Bool Function(frame_key, frame_key)>>(
+          'frame_key_equal');
+  late final _frame_key_equal =
+      _frame_key_equalPtr.asFunction<bool Function(frame_key, frame_key)>();
+
+  bool frame_key_same_indices(
+    frame_key a,
+    frame_key b,
+  ) {
+    return _frame_key_same_indices(
+      a,
+      b,
+    );
+  }
+
+  late final _frame_key_same_indicesPtr =
+      _lookup<ffi.NativeFunction<ffi.Bool Function(frame_key, frame_key)>>(
+          'frame_key_same_indices');
+  late final _frame_key_same_indices = _frame_key_same_indicesPtr
+      .asFunction<bool Function(frame_key, frame_key)>();
+
+  bool frame_inputs_equal(
+    frame_inputs a,
+    frame_inputs b,
+  ) {
+    return _frame_inputs_equal(
+      a,
+      b,
+    );
+  }
+
+  late final _frame_inputs_equalPtr = _lookup<
+          ffi.NativeFunction<ffi.Bool Function(frame_inputs, frame_inputs)>>(
+      'frame_inputs_equal');
+  late final _frame_inputs_equal = _frame_inputs_equalPtr
+      .asFunction<bool Function(frame_inputs, frame_inputs)>();
+
+  bool rgba_equal(
+    rgba a,
+    rgba b,
+  ) {
+    return _rgba_equal(
+      a,
+      b,
+    );
+  }
+
+  late final _rgba_equalPtr =
+      _lookup<ffi.NativeFunction<ffi.Bool Function(rgba, rgba)>>('rgba_equal');
+  late final _rgba_equal =
+      _rgba_equalPtr.asFunction<bool Function(rgba, rgba)>();
+
+  int round_double_to_int(
+    double x,
+  ) {
+    return _round_double_to_int(
+      x,
+    );
+  }
+
+  late final _round_double_to_intPtr =
+      _lookup<ffi.NativeFunction<ffi.Int Function(ffi.Double)>>(
+          'round_double_to_int');
+  late final _round_double_to_int =
+      _round_double_to_intPtr.asFunction<int Function(double)>();
+}
+
+/// Ids of the registered backgrounds
+abstract class configuration {
+  static const int grid = 0;
+  static const int wave = 1;
+  static const int num_configurations = 2;
+}
+
+abstract class render_mode {
+  static const int render_sync = 0;
+  static const int render_async = 1;
+}
+
+/// What draw_background did with a request
+abstract class draw_status {
+  /// A frame was started, it reaches frame_callback once rendered
+  static const int draw_started = 0;
+
+  /// The background would come out the same as the last frame, nothing is rendered and no frame follows
+  static const int draw_unchanged = 1;
+
+  /// No frame could start now, a later call renders from the newest request
+  static const int draw_deferred = 2;
+
+  /// submit_commands was given a stream it could not read or find the memory for, none of it was applied
+  static const int draw_rejected = 3;
+}
+
+/// Commands of a submit_commands stream, each an opcode byte followed by its operands, little-endian
+abstract class command_opcode {
+  /// uint8_t config, as update_background_config
+  static const int command_config = 0;
+
+  /// int32_t increment, as update_background_color
+  static const int command_color = 1;
+
+  /// uint64_t width, height
+  static const int command_size = 2;
+
+  /// uint32_t count, then count entities as uint8_t kind, r, g, b, a and float x0, y0, x1, y1, x2, y2, width
+  static const int command_entities = 3;
+
+  /// uint64_t cycle_time, int64_t x_offset, y_offset, as draw_background
+  static const int command_draw = 4;
+}
+
+/// Fraction of the output resolution that is actually rendered, the rest is filled by upscaling
+abstract class render_scale {
+  static const int render_scale_full = 0;
+  static const int render_scale_half = 1;
+  static const int render_scale_quarter = 2;
+}
+
+/// Hardware counters sampled around every tile once set_perf_counters turned them on
+abstract class perf_counter {
+  static const int perf_cycles = 0;
+  static const int perf_instructions = 1;
+
+  /// Misses of the last level cache, which have to go to memory
+  static const int perf_llc_misses = 2;
+
+  /// Cycles the back end of the core could not make progress, mostly waiting on memory
+  static const int perf_stalled_cycles = 3;
+  static const int num_perf_counters = 4;
+}
+
+/// How the system schedules render workers, see set_worker_placement
+abstract class worker_policy {
+  static const int worker_policy_default = 0;
+
+  /// Longer time slices and no preemption boosts, for throughput over latency
+  static const int worker_policy_batch = 1;
+
+  /// Only runs when nothing else wants the CPU
+  static const int worker_policy_idle = 2;
+
+  /// Real time policies, usually only granted to privileged processes
+  static const int worker_policy_fifo = 3;
+  static const int worker_policy_round_robin = 4;
+}
+
+/// Shapes set_entities draws over the background, coordinates are logical pixels
+abstract class entity_kind {
+  /// Filled circle around x0, y0, width is its radius
+  static const int entity_circle = 0;
+
+  /// Rectangle from x0, y0 to x1, y1, filled when width is zero and otherwise only a border width thick inside it
+  static const int entity_rect = 1;
+
+  /// Segment from x0, y0 to x1, y1 width thick with square ends, drawn along the axis it is longer on
+  static const int entity_line = 2;
+
+  /// Filled triangle x0, y0, x1, y1, x2, y2
+  static const int entity_triangle = 3;
+}
+
+abstract class kernel_isa {
+  static const int kernel_isa_auto = 0;
+  static const int kernel_isa_scalar = 1;
+  static const int kernel_isa_sse2 = 2;
+  static const int kernel_isa_avx2 = 3;
+  static const int kernel_isa_neon = 4;
+}
+
+final class range extends ffi.Struct {
+  @ffi.Double()
+  external double offset;
+
+  @ffi.Double()
+  external double tolerance;
+}
+
+/// Half-open run of pixels [start, end) within a row
+final class span extends ffi.Struct {
+  @ffi.Uint32()
+  external int start;
+
+  @ffi.Uint32()
+  external int end;
+}
+
+/// Area of a frame in pixels, from its top left corner
+final class rect extends ffi.Struct {
+  @ffi.Uint32()
+  external int x;
+
+  @ffi.Uint32()
+  external int y;
+
+  @ffi.Uint32()
+  external int width;
+
+  @ffi.Uint32()
+  external int height;
+}
+
+/// How a frame relates to the one presented before it, base_frame_id, when the background only moved
+final class frame_shift extends ffi.Struct {
+  /// Set when both frames have the same background, size, scale and colors, the rest is meaningless otherwise
+  @ffi.Bool()
+  external bool valid;
+
+  /// Set when every pixel outside the strips is the pixel of the base frame dx, dy away.
+  /// Otherwise dx, dy is only how far the background moved overall.
+  @ffi.Bool()
+  external bool exact;
+
+  /// Only the strips were rendered, the rest of the frame is the base frame shifted by dx, dy
+  @ffi.Bool()
+  external bool strips_only;
+
+  @ffi.Uint64()
+  external int base_frame_id;
+
+  /// Whole output pixels, positive to the right and down
+  @ffi.Int64()
+  external int dx;
+
+  @ffi.Int64()
+  external int dy;
+
+  /// Areas the shifted base frame leaves uncovered, the whole frame when it moved out of view
+  @ffi.Uint32()
+  external int num_strips;
+
+  @ffi.Array.multi([2])
+  external ffi.Array<rect> strips;
+}
+
+final class rgba extends ffi.Struct {
+  @ffi.Uint8()
+  external int r;
+
+  @ffi.Uint8()
+  external int g;
+
+  @ffi.Uint8()
+  external int b;
+
+  @ffi.Uint8()
+  external int a;
+}
+
+/// One shape drawn over the background, blended by the alpha of its color
+final class entity extends ffi.Struct {
+  @ffi.Uint8()
+  external int kind;
+
+  external rgba color;
+
+  @ffi.Float()
+  external double x0;
+
+  @ffi.Float()
+  external double y0;
+
+  @ffi.Float()
+  external double x1;
+
+  @ffi.Float()
+  external double y1;
+
+  @ffi.Float()
+  external double x2;
+
+  @ffi.Float()
+  external double y2;
+
+  @ffi.Float()
+  external double width;
+}
+
+/// A frame filled with the background color, with the line colored areas drawn over it as triangles
+final class geometry_frame extends ffi.Struct {
+  @ffi.Uint64()
+  external int width;
+
+  @ffi.Uint64()
+  external int height;
+
+  external rgba background_color;
+
+  external rgba line_color;
+
+  /// Output pixel x, y pairs, every three vertices make a triangle
+  @ffi.Uint32()
+  external int num_vertices;
+
+  external ffi.Pointer<ffi.Float> vertices;
+}
+
+/// Renderers write one of these per pixel, expanded to the frame's colors afterwards
+abstract class palette_index {
+  static const int palette_background = 0;
+  static const int palette_line = 1;
+}
+
+abstract class row_kind {
+  static const int row_kind_unknown = 0;
+  static const int row_kind_spans = 1;
+  static const int row_kind_grid_template = 2;
+}
+
+/// What a framebuffer row currently holds, used to only rewrite what changed in the next frame
+final class row_state extends ffi.Struct {
+  @ffi.Uint16()
+  external int kind;
+
+  @ffi.Uint16()
+  external int num_spans;
+
+  /// Grid rows record which template they were copied from
+  @ffi.Uint32()
+  external int template_index;
+
+  @ffi.Array.multi([16])
+  external ffi.Array<span> spans;
+}
+
+final class colors extends ffi.Struct {
+  external rgba background_color;
+
+  external rgba line_color;
+
+  external rgba widget_color;
+}
+
+/// The inputs that decide whether a framebuffer's content can be updated in place
+final class frame_key extends ffi.Struct {
+  @ffi.Int32()
+  external int config;
+
+  @ffi.Uint64()
+  external int width;
+
+  @ffi.Uint64()
+  external int height;
+
+  @ffi.Uint64()
+  external int render_width;
+
+  @ffi.Uint64()
+  external int render_height;
+
+  @ffi.Uint32()
+  external int scale_shift;
+
+  @ffi.Double()
+  external double sample_scale;
+
+  external rgba background_color;
+
+  external rgba line_color;
+
+  @ffi.Int64()
+  external int x_offset;
+}
+
+/// Everything the pixels of a frame come from, frames with equal inputs are identical
+final class frame_inputs extends ffi.Struct {
+  @ffi.Int32()
+  external int config;
+
+  @ffi.Uint64()
+  external int width;
+
+  @ffi.Uint64()
+  external int height;
+
+  @ffi.Double()
+  external double device_pixel_ratio;
+
+  @ffi.Uint32()
+  external int scale_shift;
+
+  external rgba background_color;
+
+  external rgba line_color;
+
+  /// Zero for the ones the background does not depend on
+  @ffi.Uint64()
+  external int cycle_time;
+
+  @ffi.Int64()
+  external int x_offset;
+
+  @ffi.Int64()
+  external int y_offset;
+
+  /// Zero while no entity is drawn over the background, changed by every set_entities that changes them
+  @ffi.Uint64()
+  external int entities_version;
+}
+
+/// Everything a worker needs to render its rows, captured once per frame
+final class image_settings extends ffi.Struct {
+  @ffi.Int32()
+  external int config;
+
+  @ffi.Uint64()
+  external int cycle_time;
+
+  @ffi.Uint64()
+  external int x_offset;
+
+  @ffi.Uint64()
+  external int y_offset;
+
+  @ffi.Uint64()
+  external int start_row;
+
+  @ffi.Uint64()
+  external int end_row;
+
+  /// Rows and widths renderers work with, before upscaling
+  @ffi.Uint64()
+  external int width;
+
+  @ffi.Uint64()
+  external int height;
+
+  @ffi.Uint64()
+  external int output_width;
+
+  @ffi.Uint64()
+  external int output_height;
+
+  @ffi.Uint64()
+  external int stride;
+
+  @ffi.Uint32()
+  external int scale_shift;
+
+  /// Logical pixels covered by one rendered pixel
+  @ffi.Double()
+  external double sample_scale;
+
+  @ffi.Uint64()
+  external int logical_width;
+
+  external colors colors1;
+
+  external ffi.Pointer<rgba> pixels;
+
+  external ffi.Pointer<row_state> rows;
+
+  external ffi.Pointer<ffi.Uint8> indices;
+
+  @ffi.Bool()
+  external bool incremental;
+
+  /// The rows are expanded from their palette indices rather than written in place
+  @ffi.Bool()
+  external bool expand;
+
+  /// RGBA bytes written to the frame by the rows rendered with these settings
+  @ffi.Uint64()
+  external int bytes_written;
+
+  /// Rows outside strip_rows_start to strip_rows_end only have their pixels from strip_columns_start to strip_columns_end written.
+  /// The whole frame unless only the strips of a shifted frame are rendered.
+  @ffi.Uint64()
+  external int strip_rows_start;
+
+  @ffi.Uint64()
+  external int strip_rows_end;
+
+  @ffi.Uint64()
+  external int strip_columns_start;
+
+  @ffi.Uint64()
+  external int strip_columns_end;
+}
+
+final class image extends ffi.Struct {
+  @ffi.Uint64()
+  external int width;
+
+  @ffi.Uint64()
+  external int height;
+
+  @ffi.Int32()
+  external int config;
+}
+
+/// Palette indices of a held frame at its render resolution, rows are stride bytes apart
+final class index_plane extends ffi.Struct {
+  external ffi.Pointer<ffi.Uint8> indices;
+
+  @ffi.Uint64()
+  external int width;
+
+  @ffi.Uint64()
+  external int height;
+
+  @ffi.Uint64()
+  external int stride;
+
+  @ffi.Array.multi([2])
+  external ffi.Array<rgba> palette;
+}
+
+/// Moves the render scale to keep the time spent rendering each frame within budget
+final class render_scale_controller extends ffi.Struct {
+  @ffi.Uint32()
+  external int scale_shift;
+
+  @ffi.Double()
+  external double device_pixel_ratio;
+
+  /// Zero keeps the scale fixed
+  @ffi.Double()
+  external double budget_milliseconds;
+
+  @ffi.Double()
+  external double average_milliseconds;
+
+  @ffi.Uint32()
+  external int frames_at_scale;
+}
+
+/// Parameters of the latest draw_background, every frame is prepared from the newest ones
+final class render_request extends ffi.Struct {
+  @ffi.Uint64()
+  external int cycle_time;
+
+  @ffi.Int64()
+  external int x_offset;
+
+  @ffi.Int64()
+  external int y_offset;
+
+  @ffi.Uint64()
+  external int requested_nanoseconds;
+
+  /// Cleared by shutdown, nothing is rendered from the request until draw_background made one
+  @ffi.Bool()
+  external bool valid;
+}
+
+/// What a command stream leaves the background as, read in full before any of it reaches the context
+final class command_batch extends ffi.Struct {
+  @ffi.Uint8()
+  external int config;
+
+  external rgba background_color;
+
+  @ffi.Uint64()
+  external int width;
+
+  @ffi.Uint64()
+  external int height;
+
+  /// Set when the stream replaced the entities, they are decoded into the context's command_entities
+  @ffi.Bool()
+  external bool entities;
+
+  @ffi.Uint32()
+  external int num_entities;
+
+  /// Valid when the stream asked for a draw, the newest one
+  external render_request request;
+}
+
+/// One worker's share of a frame, times are monotonic_nanoseconds
+final class worker_timing extends ffi.Struct {
+  @ffi.Uint64()
+  external int start_nanoseconds;
+
+  @ffi.Uint64()
+  external int end_nanoseconds;
+
+  @ffi.Uint32()
+  external int tiles;
+
+  @ffi.Uint64()
+  external int bytes_written;
+
+  /// Bit i set when counters[i] was measured, zero when the counters are off or were refused
+  @ffi.Uint32()
+  external int counter_mask;
+
+  @ffi.Array.multi([4])
+  external ffi.Array<ffi.Uint64> counters;
+
+  /// CPUs the worker started and finished its share on, -1 where the system does not tell
+  @ffi.Int32()
+  external int first_cpu;
+
+  @ffi.Int32()
+  external int last_cpu;
+}
+
+/// Where the time of a presented frame went, times are monotonic_nanoseconds
+final class frame_stats extends ffi.Struct {
+  @ffi.Uint64()
+  external int frame_id;
+
+  @ffi.Int32()
+  external int config;
+
+  /// The draw_background call that started the frame
+  @ffi.Uint64()
+  external int requested_nanoseconds;
+
+  @ffi.Uint64()
+  external int render_started_nanoseconds;
+
+  /// Time the caller spent blocked until every worker was done, zero when rendering asynchronously
+  @ffi.Uint64()
+  external int wait_nanoseconds;
+
+  @ffi.Uint64()
+  external int presented_nanoseconds;
+
+  @ffi.Uint64()
+  external int callback_nanoseconds;
+
+  @ffi.Uint64()
+  external int bytes_written;
+
+  /// Frames lost since the previous frame was presented, for want of a free buffer or because a newer one replaced them
+  @ffi.Uint64()
+  external int dropped_frames;
+
+  /// Copied out of the frame cache rather than rendered, no worker took part
+  @ffi.Bool()
+  external bool cached;
+
+  @ffi.Uint32()
+  external int num_workers;
+
+  @ffi.Array.multi([64])
+  external ffi.Array<worker_timing> workers;
+}
+
+/// Where render workers may run and how they are scheduled
+final class worker_placement extends ffi.Struct {
+  /// Bit i for CPU i, zero for every CPU the process may use
+  @ffi.Uint64()
+  external int cpu_mask;
+
+  /// CPUs left to other threads, such as Flutter's raster thread
+  @ffi.Uint64()
+  external int reserved_cpu_mask;
+
+  /// Also leaves the CPU the caller of set_worker_placement runs on, which is Flutter's UI thread in the app
+  @ffi.Bool()
+  external bool reserve_caller_cpu;
+
+  /// One CPU per worker, in turn, rather than the whole set for all of them
+  @ffi.Bool()
+  external bool pin;
+
+  @ffi.Int32()
+  external int policy;
+
+  /// Used with the default, batch and idle policies
+  @ffi.Int32()
+  external int nice;
+
+  /// Used with the real time policies
+  @ffi.Int32()
+  external int priority;
+}
+
+/// What a worker ended up with, read back from the system after set_worker_placement
+final class worker_placement_status extends ffi.Struct {
+  /// Zero when the affinity could not be read
+  @ffi.Uint64()
+  external int cpu_mask;
+
+  @ffi.Int32()
+  external int policy;
+
+  @ffi.Int32()
+  external int nice;
+
+  @ffi.Int32()
+  external int priority;
+
+  /// False when any part of the placement was refused, the rest is still applied
+  @ffi.Bool()
+  external bool applied;
+}
+
+final class framebuffer_memory extends ffi.Struct {
+  @ffi.Uint64()
+  external int current_bytes;
+
+  @ffi.Uint64()
+  external int peak_bytes;
+}
+
+final class frame_cache_settings extends ffi.Struct {
+  /// Memory the cached frames may take, zero turns the cache off and frees every frame in it
+  @ffi.Uint64()
+  external int budget_bytes;
+
+  /// Cycle times are rounded down to a multiple of it, one step of the animation is then a single frame
+  @ffi.Uint64()
+  external int time_quantum;
+
+  /// Cycle times are taken modulo it when it is not zero, the animation loops through a fixed set of frames
+  @ffi.Uint64()
+  external int cycle_period;
+}
+
+final class frame_cache_stats extends ffi.Struct {
+  @ffi.Uint64()
+  external int budget_bytes;
+
+  @ffi.Uint64()
+  external int used_bytes;
+
+  @ffi.Uint32()
+  external int num_frames;
+
+  /// Frames warm_frame_cache still has to render
+  @ffi.Uint32()
+  external int warm_frames_left;
+
+  @ffi.Uint64()
+  external int hits;
+
+  @ffi.Uint64()
+  external int misses;
+
+  @ffi.Uint64()
+  external int evictions;
+}
+
+final class context extends ffi.Struct {
+  external frame_callback frame_callback1;
+
+  external colors colors1;
+
+  external image background;
+
+  external ffi.Pointer<background_registry> backgrounds;
+
+  @ffi.Uint32()
+  external int num_image_threads;
+
+  external image_settings frame_settings;
+
+  external ffi.Pointer<tile_scheduler> scheduler;
+
+  external ffi.Pointer<worker_pool> pool;
+
+  external ffi.Pointer<framebuffer_ring> framebuffers;
+
+  external ffi.Pointer<frame_stats_ring> frame_stats1;
+
+  /// Set from C_LAYER_TRACE, the trace recorded since initialize is written there on shutdown
+  external ffi.Pointer<ffi.Char> trace_path;
+
+  /// One set per worker while set_perf_counters has them on, each opened by its worker on its next frame
+  external ffi.Pointer<perf_counters> perf_counters1;
+
+  external worker_placement placement;
+
+  @ffi.Int32()
+  external int placement_caller_cpu;
+
+  @ffi.Array.multi([64])
+  external ffi.Array<worker_placement_status> placement_status;
+
+  @ffi.Int32()
+  external int render_mode1;
+
+  external render_request request;
+
+  /// Set when the last frame the workers finished was given up for a newer request, written by the worker that finished it
+  @ffi.Bool()
+  external bool last_frame_abandoned;
+
+  /// Inputs of the last frame started, a request with the same ones is answered with draw_unchanged
+  external frame_inputs started_inputs;
+
+  @ffi.Bool()
+  external bool started_inputs_valid;
+
+  /// Only allocated while set_frame_cache has given it a budget
+  external ffi.Pointer<frame_cache> frame_cache1;
+
+  external frame_cache_settings frame_cache_settings1;
+
+  /// Next frame warm_frame_cache asked for, rendered whenever a request leaves the workers with nothing to do
+  external render_request warm_request;
+
+  @ffi.Uint32()
+  external int warm_frames_left;
+
+  /// Tells what the busy workers are rendering, a warming frame gives way to any request
+  @ffi.Bool()
+  external bool warming_in_flight;
+
+  /// Inputs of the last frame handed to the consumer, the base of the next frame's shift
+  external frame_inputs presented_inputs;
+
+  @ffi.Uint64()
+  external int presented_frame_id;
+
+  @ffi.Bool()
+  external bool presented_valid;
+
+  @ffi.Bool()
+  external bool strip_rendering;
+
+  /// Frames go to geometry_callback as geometry instead of being rasterized while it is set
+  external geometry_callback geometry_callback1;
+
+  external ffi.Pointer<geometry_ring> geometry;
+
+  /// Drawn over every pixel frame prepared after set_entities, in order
+  external ffi.Pointer<entity> entities;
+
+  @ffi.Uint32()
+  external int num_entities;
+
+  @ffi.Uint32()
+  external int entities_capacity;
+
+  @ffi.Uint64()
+  external int entities_version;
+
+  @ffi.Uint64()
+  external int entities_generation;
+
+  @ffi.Bool()
+  external bool incremental;
+
+  external render_scale_controller render_scale1;
+
+  /// Entities of the command stream being applied, decoded before set_entities copies them
+  external ffi.Pointer<entity> command_entities;
+
+  @ffi.Uint32()
+  external int command_entities_capacity;
+
+  /// Serializes every call into the library but get_frame_stats, recursive since a frame callback may call back in.
+  /// Created once by whichever call comes first and kept for the life of the process.
+  external mtx_t mutex;
+
+  @ffi.Bool()
+  external bool mutex_ready;
+}
+
+final class tile_scheduler extends ffi.Opaque {}
+
+final class worker_pool extends ffi.Opaque {}
+
+final class framebuffer_ring extends ffi.Opaque {}
+
+final class framebuffer extends ffi.Opaque {}
+
+final class background_registry extends ffi.Opaque {}
+
+final class frame_stats_ring extends ffi.Opaque {}
+
+final class perf_counters extends ffi.Opaque {}
+
+final class frame_cache extends ffi.Opaque {}
+
+final class geometry_ring extends ffi.Opaque {}
+
+final class placed_entity extends ffi.Opaque {}
+
+/// The frame's pixels stay untouched until the consumer calls release_frame with its id.
+/// Rows are row_bytes apart, which can be more than width pixels.
+typedef frame_callback
+    = ffi.Pointer<ffi.NativeFunction<frame_callbackFunction>>;
+typedef frame_callbackFunction = ffi.Void Function(
+    ffi.Uint64 frame_id,
+    ffi.Uint64 width,
+    ffi.Uint64 height,
+    ffi.Uint64 row_bytes,
+    ffi.Uint64 data_size,
+    ffi.Pointer<ffi.Void> data);
+typedef Dartframe_callbackFunction = void Function(int frame_id, int width,
+    int height, int row_bytes, int data_size, ffi.Pointer<ffi.Void> data);
+
+/// Receives frames as geometry once set_geometry_output chose it, the frame stays untouched until release_frame is called with its id.
+typedef geometry_callback
+    = ffi.Pointer<ffi.NativeFunction<geometry_callbackFunction>>;
+typedef geometry_callbackFunction = ffi.Void Function(
+    ffi.Uint64 frame_id, ffi.Pointer<geometry_frame> frame);
+typedef Dartgeometry_callbackFunction = void Function(
+    int frame_id, ffi.Pointer<geometry_frame> frame);
+
+final class mtx_t extends ffi.Struct {
+  @ffi.UintPtr()
+  external int _Type;
+
+  external ffi.Pointer<ffi.Void> _Ptr;
+
+  external ffi.Pointer<ffi.Void> _Cv;
+
+  @ffi.Uint32()
+  external int _Owner;
+
+  @ffi.Uint32()
+  external int _Cnt;
+}
+
+const int square_size = 150;
+
+const int square_stroke_thickness = 2;
+
+const int square_stroke_spacing = 50;
+
+const int num_grid_row_kinds = 4;
+
+const int max_row_spans = 16;
+
+const int num_palette_colors = 2;
+
+const int tile_rows = 16;
+
+const int max_image_threads = 64;
+
+const int frame_stats_history = 64;
+
+const int command_stream_version = 1;
+
+const int max_background_size = 16384;
+
+const int max_device_pixel_ratio = 8;
+
+const int max_render_scale_shift = 2;
+
+const int render_scale_settle_frames = 8;
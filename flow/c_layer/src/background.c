@@ -0,0 +1,64 @@
+#include "background.h"
+#include "grid.h"
+#include "wave.h"
+
+static const struct background *const builtin_backgrounds[num_configurations] = {
+  [grid] = &grid_background,
+  [wave] = &wave_background
+};
+
+void background_registry_create(struct background_registry *registry)
+{
+  for (uint32_t id = 0; id < num_configurations; id++)
+  {
+    registry->backgrounds[id] = builtin_backgrounds[id];
+    registry->states[id] = NULL;
+  }
+}
+
+const struct background *background_find(const struct background_registry *registry, uint32_t id)
+{
+  return id < num_configurations ? registry->backgrounds[id] : NULL;
+}
+
+bool background_prepare(struct background_registry *registry, const struct image_settings *settings)
+{
+  const struct background *background = background_find(registry, settings->config);
+  if (background == NULL)
+  {
+    return false;
+  }
+
+  // Kept once created, switching back to a background reuses what it had prepared
+  if (registry->states[settings->config] == NULL)
+  {
+    registry->states[settings->config] = background->create();
+    if (registry->states[settings->config] == NULL)
+    {
+      return false;
+    }
+  }
+  return background->prepare(registry->states[settings->config], settings);
+}
+
+void background_render_tile(const struct background_registry *registry, struct image_settings *settings)
+{
+  registry->backgrounds[settings->config]->render_tile(registry->states[settings->config], settings);
+}
+
+const struct span *background_row_spans(const struct background_registry *registry, const struct image_settings *settings, uint64_t y, struct span scratch[max_row_spans], uint32_t *num_spans)
+{
+  return registry->backgrounds[settings->config]->row_spans(registry->states[settings->config], settings, y, scratch, num_spans);
+}
+
+void background_registry_destroy(struct background_registry *registry)
+{
+  for (uint32_t id = 0; id < num_configurations; id++)
+  {
+    if (registry->states[id] != NULL)
+    {
+      registry->backgrounds[id]->free(registry->states[id]);
+      registry->states[id] = NULL;
+    }
+  }
+}
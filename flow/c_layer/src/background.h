@@ -0,0 +1,49 @@
+#pragma once
+
+#include "c_layer.h"
+
+// Frame parameters a background may depend on, besides the size, scale and colors every background depends on
+typedef enum
+{
+    background_input_cycle_time = 1 << 0,
+    background_input_x_offset = 1 << 1,
+    background_input_y_offset = 1 << 2
+} background_input;
+
+// A kind of background, selected by its configuration id.
+// prepare runs once per frame before any tile is rendered and keeps what it derives in its state, across frames when it can.
+// render_tile then draws the rows of settings, called from every worker at the same time.
+// shift tells how far, in logical pixels, the picture moved between the frames of two inputs, and whether it did nothing but move.
+// row_spans gives the line colored runs of a row after prepare, in order, either in scratch or in memory of the state.
+struct background
+{
+    const char *name;
+    void *(*create)(void);
+    bool (*prepare)(void *state, const struct image_settings *settings);
+    void (*render_tile)(const void *state, struct image_settings *settings);
+    void (*free)(void *state);
+    // Mask of background_input, a request that changes none of them and nothing else comes out the same and is not rendered
+    uint32_t inputs;
+    bool (*shift)(const struct frame_inputs *from, const struct frame_inputs *to, double *dx, double *dy);
+    // NULL for backgrounds that are more than runs of two colors, they are only ever rasterized
+    const struct span *(*row_spans)(const void *state, const struct image_settings *settings, uint64_t y, struct span scratch[max_row_spans], uint32_t *num_spans);
+};
+
+// Every background that can be drawn, states are created the first time one is prepared
+struct background_registry
+{
+    const struct background *backgrounds[num_configurations];
+    void *states[num_configurations];
+};
+
+void background_registry_create(struct background_registry *registry);
+
+const struct background *background_find(const struct background_registry *registry, uint32_t id);
+
+bool background_prepare(struct background_registry *registry, const struct image_settings *settings);
+
+void background_render_tile(const struct background_registry *registry, struct image_settings *settings);
+
+const struct span *background_row_spans(const struct background_registry *registry, const struct image_settings *settings, uint64_t y, struct span scratch[max_row_spans], uint32_t *num_spans);
+
+void background_registry_destroy(struct background_registry *registry);
@@ -0,0 +1,479 @@
+#include "../c_layer.h"
+
+#include <time.h>
+
+#define max_sweep_values 16
+// Entities build_scene makes every frame
+#define scene_entities 80
+
+struct resolution
+{
+    const char *name;
+    uint64_t width, height;
+};
+
+static const struct resolution resolutions[] = {
+  {"720p", 1280, 720},
+  {"1080p", 1920, 1080},
+  {"1440p", 2560, 1440},
+  {"4k", 3840, 2160},
+  {"8k", 7680, 4320}
+};
+
+#define num_resolutions (int)(sizeof(resolutions) / sizeof(resolutions[0]))
+
+static const char *const configuration_names[num_configurations] = {
+  [grid] = "grid",
+  [wave] = "wave"
+};
+
+static const char *const perf_counter_names[num_perf_counters] = {
+  [perf_cycles] = "cycles",
+  [perf_instructions] = "instructions",
+  [perf_llc_misses] = "llc_misses",
+  [perf_stalled_cycles] = "stalled_cycles"
+};
+
+struct bench_options
+{
+    uint32_t frames;
+    uint32_t warmup_frames;
+    bool incremental;
+    bool strips;
+    bool geometry;
+    bool entities;
+    bool perf_counters;
+    bool pin;
+    uint32_t threads[max_sweep_values];
+    int num_threads;
+    bool configurations[num_configurations];
+    bool resolutions[num_resolutions];
+    const char *output;
+};
+
+struct bench_result
+{
+    double nanoseconds_per_pixel;
+    double frames_per_second;
+    double p50_milliseconds;
+    double p99_milliseconds;
+    double max_milliseconds;
+    // RGBA bytes written per frame, or the size of the geometry handed out
+    double bytes_per_frame;
+    // Per measured frame, summed over the workers, for the counters in the perf_counters mask
+    uint32_t perf_counters;
+    double counters[num_perf_counters];
+    uint32_t pinned_workers;
+};
+
+// Frames are handed straight back, the benchmark only measures rendering
+static void release_frame_callback(uint64_t frame_id, uint64_t width, uint64_t height, uint64_t row_bytes, uint64_t data_size, void *data)
+{
+  (void)width, (void)height, (void)row_bytes, (void)data_size, (void)data;
+  release_frame(frame_id);
+}
+
+static void release_geometry_callback(uint64_t frame_id, const struct geometry_frame *frame)
+{
+  (void)frame;
+  release_frame(frame_id);
+}
+
+// A scene the size of a game in progress, moving with the frame: the player as a circle and a triangle, 3 targets, 30 enemies,
+// 20 blocks filled and bordered, and 5 lasers. The targets stay where they are.
+static uint32_t build_scene(struct entity *entities, uint64_t width, uint64_t height, uint64_t frame)
+{
+  uint32_t count = 0;
+  float x = (float)(frame * 7 % width), y = (float)(frame * 5 % height);
+  entities[count++] = (struct entity){entity_circle, {255, 255, 255, 255}, x, y, 0, 0, 0, 0, 15};
+  entities[count++] = (struct entity){entity_triangle, {0, 0, 0, 255}, x + 15, y, x - 10, y + 8, x - 10, y - 8, 0};
+  for (uint32_t i = 0; i < 3; i++)
+  {
+    float cx = (float)((i * 401 + width / 4) % width), cy = (float)((i * 263 + height / 4) % height);
+    entities[count++] = (struct entity){entity_circle, {64, 255, 64, 255}, cx, cy, 0, 0, 0, 0, 12};
+  }
+  for (uint32_t i = 0; i < 30; i++)
+  {
+    float cx = (float)((i * 211 + frame * 3) % width), cy = (float)((i * 137 + frame * 2) % height);
+    entities[count++] = (struct entity){entity_circle, {255, 64, 64, 255}, cx, cy, 0, 0, 0, 0, 12};
+  }
+  for (uint32_t i = 0; i < 20; i++)
+  {
+    float left = (float)(i * 97 % width), top = (float)(i * 53 % height);
+    entities[count++] = (struct entity){entity_rect, {64, 64, 255, 160}, left, top, left + 60, top + 40, 0, 0, 0};
+    entities[count++] = (struct entity){entity_rect, {255, 255, 255, 255}, left, top, left + 60, top + 40, 0, 0, 2};
+  }
+  for (uint32_t i = 0; i < 5; i++)
+  {
+    float position = (float)((i * 149 + frame) % height);
+    entities[count++] = (struct entity){entity_line, {160, 0, 255, 255}, 0, position, (float)width, position, 0, 0, 6};
+  }
+  return count;
+}
+
+static double now_nanoseconds(void)
+{
+  struct timespec now;
+  timespec_get(&now, TIME_UTC);
+  return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+// Nearest rank, so p99 of fewer than 100 frames is the slowest one
+static double percentile(const double *sorted, uint32_t count, double fraction)
+{
+  uint32_t rank = (uint32_t)ceil(fraction * count);
+  return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static bool run(const struct bench_options *options, configuration config, const struct resolution *resolution, uint32_t num_threads, struct bench_result *result)
+{
+  double *frame_milliseconds = malloc(options->frames * sizeof(double));
+  if (frame_milliseconds == NULL)
+  {
+    return false;
+  }
+
+  initialize(release_frame_callback, resolution->width, resolution->height, num_threads);
+  update_background_config(config);
+  set_incremental_rendering(options->incremental);
+  set_strip_rendering(options->strips);
+  set_geometry_output(options->geometry ? release_geometry_callback : NULL);
+  result->perf_counters = options->perf_counters ? set_perf_counters(1) : 0;
+  if (options->pin)
+  {
+    // One CPU per worker, away from the one measuring
+    struct worker_placement placement = {0, 0, true, true, worker_policy_default, 0, 0};
+    result->pinned_workers = set_worker_placement(&placement);
+  }
+  for (int i = 0; i < num_perf_counters; i++)
+  {
+    result->counters[i] = 0;
+  }
+  result->bytes_per_frame = 0;
+
+  // Time keeps moving so the wave changes every frame, and the grid scrolls by a few pixels
+  uint64_t cycle_time = 0;
+  for (uint32_t frame = 0; frame < options->warmup_frames; frame++, cycle_time++)
+  {
+    draw_background(cycle_time, cycle_time * 3, cycle_time * 2);
+  }
+
+  static struct entity scene[scene_entities];
+  // Frame ids start at 1, the stats of a frame are only counted the first time they are seen
+  static struct frame_stats stats;
+  uint64_t last_frame_id = get_frame_stats(&stats, 1) == 1 ? stats.frame_id : 0;
+  double total_nanoseconds = 0;
+  for (uint32_t frame = 0; frame < options->frames; frame++, cycle_time++)
+  {
+    double start = now_nanoseconds();
+    if (options->entities)
+    {
+      set_entities(scene, build_scene(scene, resolution->width, resolution->height, frame));
+    }
+    draw_status status = draw_background(cycle_time, cycle_time * 3, cycle_time * 2);
+    double elapsed = now_nanoseconds() - start;
+    total_nanoseconds += elapsed;
+    frame_milliseconds[frame] = elapsed / 1e6;
+
+    // Frames are rendered synchronously, the latest stats are the ones of this frame when one was started.
+    // Calls that rendered nothing add nothing to the averages.
+    if (status != draw_started || get_frame_stats(&stats, 1) != 1 || stats.frame_id == last_frame_id)
+    {
+      continue;
+    }
+    last_frame_id = stats.frame_id;
+    result->bytes_per_frame += stats.bytes_written / (double)options->frames;
+    if (result->perf_counters != 0)
+    {
+      for (uint32_t worker = 0; worker < stats.num_workers; worker++)
+      {
+        for (int i = 0; i < num_perf_counters; i++)
+        {
+          result->counters[i] += stats.workers[worker].counters[i] / (double)options->frames;
+        }
+      }
+    }
+  }
+  shutdown();
+
+  qsort(frame_milliseconds, options->frames, sizeof(double), compare_doubles);
+  result->nanoseconds_per_pixel = total_nanoseconds / ((double)options->frames * resolution->width * resolution->height);
+  result->frames_per_second = options->frames / (total_nanoseconds / 1e9);
+  result->p50_milliseconds = percentile(frame_milliseconds, options->frames, 0.5);
+  result->p99_milliseconds = percentile(frame_milliseconds, options->frames, 0.99);
+  result->max_milliseconds = frame_milliseconds[options->frames - 1];
+  free(frame_milliseconds);
+  return true;
+}
+
+// Counters per frame, null for those the system would not count, and what they add up to
+static void print_counters(FILE *output, const struct bench_result *result)
+{
+  fprintf(output, ", \"counters_per_frame\": {");
+  for (int i = 0; i < num_perf_counters; i++)
+  {
+    fprintf(output, i > 0 ? ", \"%s\": " : "\"%s\": ", perf_counter_names[i]);
+    if (result->perf_counters & (1u << i))
+    {
+      fprintf(output, "%.0f", result->counters[i]);
+    }
+    else
+    {
+      fprintf(output, "null");
+    }
+  }
+  fprintf(output, "}");
+
+  // Few instructions per cycle with many stalls and misses means the frame waits on memory rather than on compute
+  uint32_t needed = (1u << perf_cycles) | (1u << perf_instructions);
+  if ((result->perf_counters & needed) == needed && result->counters[perf_cycles] > 0 && result->counters[perf_instructions] > 0)
+  {
+    fprintf(output, ", \"instructions_per_cycle\": %.3f", result->counters[perf_instructions] / result->counters[perf_cycles]);
+    if (result->perf_counters & (1u << perf_llc_misses))
+    {
+      fprintf(output, ", \"llc_misses_per_kilo_instruction\": %.3f", result->counters[perf_llc_misses] * 1000 / result->counters[perf_instructions]);
+    }
+    if (result->perf_counters & (1u << perf_stalled_cycles))
+    {
+      fprintf(output, ", \"stalled_cycle_fraction\": %.3f", result->counters[perf_stalled_cycles] / result->counters[perf_cycles]);
+    }
+  }
+}
+
+static void print_usage(const char *program)
+{
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  --frames N          measured frames per run (default 120)\n"
+          "  --warmup N          frames rendered before measuring (default 10)\n"
+          "  --threads A,B,...   worker counts to sweep, 0 for one per core (default 1,2,4,8)\n"
+          "  --config NAME,...   grid, wave (default both)\n"
+          "  --resolution NAME,...  720p, 1080p, 1440p, 4k, 8k (default all)\n"
+          "  --incremental       only rewrite what changed between frames\n"
+          "  --strips            only render what scrolled into view when the frame is the previous one shifted\n"
+          "  --geometry          hand frames out as triangles instead of pixels\n"
+          "  --entities          draw a game's worth of circles, rectangles, lines and triangles over every frame\n"
+          "  --perf-counters     sample hardware counters around every tile, Linux only\n"
+          "  --pin               pin every worker to a CPU of its own, away from the benchmark thread\n"
+          "  --output PATH       write the JSON results there instead of stdout\n",
+          program);
+}
+
+// Marks every name of the comma separated list found in names, false if one is unknown
+static bool parse_names(const char *list, const char *const *names, int num_names, bool *selected)
+{
+  for (int i = 0; i < num_names; i++)
+  {
+    selected[i] = false;
+  }
+  while (*list != '\0')
+  {
+    size_t length = strcspn(list, ",");
+    int found = -1;
+    for (int i = 0; i < num_names; i++)
+    {
+      if (strlen(names[i]) == length && strncmp(list, names[i], length) == 0)
+      {
+        found = i;
+      }
+    }
+    if (found < 0)
+    {
+      return false;
+    }
+    selected[found] = true;
+    list += length;
+    list += *list == ',';
+  }
+  return true;
+}
+
+static bool parse_counts(const char *list, uint32_t *counts, int *num_counts)
+{
+  *num_counts = 0;
+  while (*list != '\0')
+  {
+    char *end;
+    unsigned long count = strtoul(list, &end, 10);
+    if (end == list || (*end != ',' && *end != '\0') || *num_counts == max_sweep_values)
+    {
+      return false;
+    }
+    counts[(*num_counts)++] = (uint32_t)count;
+    list = end + (*end == ',');
+  }
+  return true;
+}
+
+static bool parse_options(int argc, char **argv, struct bench_options *options)
+{
+  *options = (struct bench_options){120, 10, false, false, false, false, false, false, {1, 2, 4, 8}, 4, {true, true}, {true, true, true, true, true}, NULL};
+
+  const char *resolution_names[num_resolutions];
+  for (int i = 0; i < num_resolutions; i++)
+  {
+    resolution_names[i] = resolutions[i].name;
+  }
+
+  for (int i = 1; i < argc; i++)
+  {
+    const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+    if (strcmp(argv[i], "--incremental") == 0)
+    {
+      options->incremental = true;
+      continue;
+    }
+    if (strcmp(argv[i], "--strips") == 0)
+    {
+      options->strips = true;
+      continue;
+    }
+    if (strcmp(argv[i], "--geometry") == 0)
+    {
+      options->geometry = true;
+      continue;
+    }
+    if (strcmp(argv[i], "--entities") == 0)
+    {
+      options->entities = true;
+      continue;
+    }
+    if (strcmp(argv[i], "--perf-counters") == 0)
+    {
+      options->perf_counters = true;
+      continue;
+    }
+    if (strcmp(argv[i], "--pin") == 0)
+    {
+      options->pin = true;
+      continue;
+    }
+    if (value == NULL)
+    {
+      return false;
+    }
+    i++;
+
+    if (strcmp(argv[i - 1], "--frames") == 0)
+    {
+      options->frames = (uint32_t)strtoul(value, NULL, 10);
+    }
+    else if (strcmp(argv[i - 1], "--warmup") == 0)
+    {
+      options->warmup_frames = (uint32_t)strtoul(value, NULL, 10);
+    }
+    else if (strcmp(argv[i - 1], "--threads") == 0)
+    {
+      if (!parse_counts(value, options->threads, &options->num_threads))
+      {
+        return false;
+      }
+    }
+    else if (strcmp(argv[i - 1], "--config") == 0)
+    {
+      if (!parse_names(value, configuration_names, num_configurations, options->configurations))
+      {
+        return false;
+      }
+    }
+    else if (strcmp(argv[i - 1], "--resolution") == 0)
+    {
+      if (!parse_names(value, resolution_names, num_resolutions, options->resolutions))
+      {
+        return false;
+      }
+    }
+    else if (strcmp(argv[i - 1], "--output") == 0)
+    {
+      options->output = value;
+    }
+    else
+    {
+      return false;
+    }
+  }
+  return options->frames > 0 && options->num_threads > 0;
+}
+
+int main(int argc, char **argv)
+{
+  struct bench_options options;
+  if (!parse_options(argc, argv, &options))
+  {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  FILE *output = options.output != NULL ? fopen(options.output, "w") : stdout;
+  if (output == NULL)
+  {
+    fprintf(stderr, "cannot open %s\n", options.output);
+    return 1;
+  }
+
+  fprintf(output, "{\n  \"frames\": %u,\n  \"warmup_frames\": %u,\n  \"incremental\": %s,\n  \"strips\": %s,\n  \"geometry\": %s,\n  \"entities\": %s,\n  \"results\": [",
+          options.frames, options.warmup_frames, options.incremental ? "true" : "false", options.strips ? "true" : "false", options.geometry ? "true" : "false",
+          options.entities ? "true" : "false");
+  bool first = true;
+  bool warned_counters = false;
+  for (int config = 0; config < num_configurations; config++)
+  {
+    for (int resolution_index = 0; resolution_index < num_resolutions; resolution_index++)
+    {
+      for (int thread_index = 0; thread_index < options.num_threads; thread_index++)
+      {
+        if (!options.configurations[config] || !options.resolutions[resolution_index])
+        {
+          continue;
+        }
+
+        const struct resolution *resolution = &resolutions[resolution_index];
+        uint32_t num_threads = options.threads[thread_index] > 0 ? options.threads[thread_index] : detect_core_count();
+        struct bench_result result;
+        if (!run(&options, config, resolution, num_threads, &result))
+        {
+          fprintf(stderr, "out of memory\n");
+          return 1;
+        }
+
+        if (options.perf_counters && result.perf_counters == 0 && !warned_counters)
+        {
+          fprintf(stderr, "hardware counters are not available here, perf_event_open was refused or this is not Linux\n");
+          warned_counters = true;
+        }
+        // Progress goes to stderr so the JSON can be piped
+        fprintf(stderr, "%s %s threads=%u  %.3f ns/pixel  %.1f fps  p50 %.2f ms  p99 %.2f ms  max %.2f ms  %.0f KB/frame\n", configuration_names[config], resolution->name,
+                num_threads, result.nanoseconds_per_pixel, result.frames_per_second, result.p50_milliseconds, result.p99_milliseconds, result.max_milliseconds,
+                result.bytes_per_frame / 1024);
+        fprintf(output,
+                "%s\n    {\"configuration\": \"%s\", \"resolution\": \"%s\", \"width\": %llu, \"height\": %llu, \"threads\": %u, "
+                "\"ns_per_pixel\": %.4f, \"frames_per_second\": %.2f, \"p50_ms\": %.4f, \"p99_ms\": %.4f, \"max_ms\": %.4f, \"bytes_per_frame\": %.0f",
+                first ? "" : ",", configuration_names[config], resolution->name, (unsigned long long)resolution->width, (unsigned long long)resolution->height, num_threads,
+                result.nanoseconds_per_pixel, result.frames_per_second, result.p50_milliseconds, result.p99_milliseconds, result.max_milliseconds, result.bytes_per_frame);
+        if (options.perf_counters)
+        {
+          print_counters(output, &result);
+        }
+        if (options.pin)
+        {
+          fprintf(output, ", \"pinned_workers\": %u", result.pinned_workers);
+        }
+        fprintf(output, "}");
+        first = false;
+      }
+    }
+  }
+  fprintf(output, "\n  ]\n}\n");
+
+  if (output != stdout)
+  {
+    fclose(output);
+  }
+  return 0;
+}
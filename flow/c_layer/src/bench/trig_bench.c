@@ -0,0 +1,72 @@
+#include "../trig.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define num_samples (1u << 24)
+
+static double elapsed_nanoseconds(struct timespec start, struct timespec end)
+{
+  return (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+}
+
+int main(int argc, char **argv)
+{
+  uint32_t rounds = argc > 1 ? (uint32_t)atoi(argv[1]) : 4;
+  const double turn = 2 * 3.14159265358979323846;
+
+  // Every 256th phase across the whole turn, wide enough to catch the worst interpolation error
+  double max_error = 0;
+  for (uint64_t phase = 0; phase < (1ull << 32); phase += 256)
+  {
+    double expected = sin(phase * turn / 4294967296.0);
+    double error = fabs(trig_sin((uint32_t)phase) / (double)trig_one - expected);
+    if (error > max_error)
+    {
+      max_error = error;
+    }
+  }
+
+  // Same inputs as the wave kernel hands out, an arbitrary stride so phases are not sequential in the table
+  volatile int64_t table_sink = 0;
+  volatile double libm_sink = 0;
+  double table_nanoseconds = 0, libm_nanoseconds = 0;
+  for (uint32_t round = 0; round < rounds; round++)
+  {
+    struct timespec start, end;
+
+    timespec_get(&start, TIME_UTC);
+    int64_t table_sum = 0;
+    uint32_t phase = round;
+    for (uint32_t i = 0; i < num_samples; i++)
+    {
+      table_sum += trig_sin(phase);
+      phase += 2654435761u;
+    }
+    timespec_get(&end, TIME_UTC);
+    table_sink = table_sum;
+    table_nanoseconds += elapsed_nanoseconds(start, end);
+
+    timespec_get(&start, TIME_UTC);
+    double libm_sum = 0;
+    phase = round;
+    for (uint32_t i = 0; i < num_samples; i++)
+    {
+      libm_sum += sin(phase * turn / 4294967296.0);
+      phase += 2654435761u;
+    }
+    timespec_get(&end, TIME_UTC);
+    libm_sink = libm_sum;
+    libm_nanoseconds += elapsed_nanoseconds(start, end);
+  }
+  (void)table_sink;
+  (void)libm_sink;
+
+  double calls = (double)num_samples * rounds;
+  printf("trig_sin  %.2f ns/call\n", table_nanoseconds / calls);
+  printf("libm sin  %.2f ns/call\n", libm_nanoseconds / calls);
+  printf("max error %.3g\n", max_error);
+  return 0;
+}
@@ -1,170 +1,1766 @@
 #include "c_layer.h"
+#include "background.h"
+#include "commands.h"
+#include "compositor.h"
+#include "cpu_placement.h"
+#include "frame_cache.h"
+#include "framebuffer.h"
+#include "frame_stats.h"
+#include "geometry.h"
+#include "kernels.h"
+#include "perf_counters.h"
+#include "tile_scheduler.h"
+#include "trace.h"
+#include "worker_pool.h"
 
 static struct context context;
+// Never freed, so get_frame_stats can read it without the lock while initialize and shutdown run
+static struct frame_stats_ring presented_frame_stats;
+static once_flag context_mutex_once = ONCE_FLAG_INIT;
 
-void initialize(frame_callback frame_callback, uint64_t width, uint64_t height)
+void initialize(frame_callback frame_callback, uint64_t width, uint64_t height, uint32_t num_threads)
 {
+  // Made exactly once however many threads get here first
+  call_once(&context_mutex_once, create_context_mutex);
+  lock_context();
+  if (context.pool != NULL)
+  {
+    shutdown();
+  }
+
   context.frame_callback = frame_callback;
   context.background.config = wave;
   context.background.width = width;
   context.background.height = height;
 
-  // Allocate threads
-  context.num_image_threads = 4;
-  context.image_threads = malloc(context.num_image_threads * sizeof(struct image_thread));
+  kernels_select(kernel_isa_auto);
+
+  // Start the render workers once, frames only wake them up
+  context.num_image_threads = num_threads > 0 ? num_threads : detect_core_count();
+  if (context.num_image_threads > max_image_threads)
+  {
+    context.num_image_threads = max_image_threads;
+  }
+  context.pool = malloc(sizeof(struct worker_pool));
+  if (context.pool != NULL && worker_pool_start(context.pool, context.num_image_threads))
+  {
+    context.num_image_threads = context.pool->num_workers;
+  }
+  else
+  {
+    free(context.pool);
+    context.pool = NULL;
+  }
+
+  context.scheduler = malloc(sizeof(struct tile_scheduler));
+  if (context.scheduler == NULL || !tile_scheduler_create(context.scheduler, context.num_image_threads))
+  {
+    free(context.scheduler);
+    context.scheduler = NULL;
+  }
 
   // black
   context.colors.background_color = (struct rgba){0, 0, 0, 0};
   // amber
   context.colors.line_color = (struct rgba){255, 192, 0, 0};
-  
-  context.background.pixels = malloc(context.background.height * context.background.width * sizeof(struct rgba));
-}
 
-void update_background_color(int increment)
-{
-  struct rgba new_background_color = context.colors.background_color;
-  if (new_background_color.r + increment >= 0 && new_background_color.r + increment <= 255)
+  context.render_mode = render_sync;
+  context.render_scale = (struct render_scale_controller){render_scale_full, 1, 0, 0, 0};
+  context.framebuffers = malloc(sizeof(struct framebuffer_ring));
+  if (context.framebuffers != NULL)
   {
-    new_background_color.r += increment;
+    framebuffer_ring_create(context.framebuffers);
   }
-  if (new_background_color.g + increment >= 0 && new_background_color.g + increment <= 255)
+  context.backgrounds = malloc(sizeof(struct background_registry));
+  if (context.backgrounds != NULL)
   {
-    new_background_color.g += increment;
+    background_registry_create(context.backgrounds);
   }
-  if (new_background_color.b + increment >= 0 && new_background_color.b + increment <= 255)
+  context.frame_stats = &presented_frame_stats;
+  frame_stats_ring_create(context.frame_stats);
+
+  // Tracing can be turned on for a whole run without touching the app
+  context.trace_path = getenv("C_LAYER_TRACE");
+  if (context.trace_path != NULL && context.trace_path[0] != '\0')
+  {
+    trace_start();
+  }
+  else
   {
-    new_background_color.b+= increment;
+    context.trace_path = NULL;
   }
-  context.colors.background_color = new_background_color;
+  unlock_context();
+}
+
+void update_background_color(int increment)
+{
+  lock_context();
+  context.colors.background_color = step_background_color(context.colors.background_color, increment);
+  unlock_context();
 }
 
 void update_background_size(uint64_t width, uint64_t height, uint64_t cycle_time, int64_t x_offset, int64_t y_offset)
 {
+  if (width > max_background_size || height > max_background_size)
+  {
+    return;
+  }
+  lock_context();
   context.background.width = width;
   context.background.height = height;
   draw_background(cycle_time, x_offset, y_offset);
+  unlock_context();
 }
 
 void update_background_config(uint8_t config_byte)
 {
-  context.background.config = config_byte;
+  lock_context();
+  // Ids without a registered background keep the current one
+  if (config_byte < num_configurations)
+  {
+    context.background.config = config_byte;
+  }
+
+  // Shown right away from the latest request rather than on the next draw_background
+  if (context.request.valid)
+  {
+    context.request.requested_nanoseconds = monotonic_nanoseconds();
+    render_latest_request();
+  }
+  unlock_context();
+}
+
+uint8_t draw_background(uint64_t cycle_time, int64_t x_offset, int64_t y_offset)
+{
+  lock_context();
+  trace_thread_name("caller", -1);
+  uint64_t trace_started = trace_begin();
+  draw_status status = render_background(cycle_time, x_offset, y_offset);
+  trace_end("draw_background", trace_started, "cycle_time", cycle_time);
+  unlock_context();
+  return status;
+}
+
+uint8_t submit_commands(const uint8_t *buffer, size_t length)
+{
+  lock_context();
+  trace_thread_name("caller", -1);
+  uint64_t trace_started = trace_begin();
+  // All of the stream is read and its memory found before any of it is applied, so a failure changes nothing
+  struct command_batch batch;
+  draw_status status = stage_commands(buffer, length, &batch) ? apply_commands(&batch) : draw_rejected;
+  trace_end("submit_commands", trace_started, "bytes", length);
+  unlock_context();
+  return status;
 }
 
-void draw_background(uint64_t cycle_time, int64_t x_offset, int64_t y_offset)
+bool stage_commands(const uint8_t *buffer, size_t length, struct command_batch *batch)
 {
-  for (int i = 0; i < context.num_image_threads; i++)
+  *batch = (struct command_batch){context.background.config, context.colors.background_color, context.background.width,
+                                  context.background.height, false, 0, {0, 0, 0, 0, false}};
+  const uint8_t *entities = NULL;
+  struct command_reader reader;
+  struct command command;
+  command_reader_start(&reader, buffer, length);
+  while (command_next(&reader, &command))
+  {
+    switch (command.opcode)
+    {
+      case command_config:
+        if (command.config < num_configurations)
+        {
+          batch->config = command.config;
+        }
+        break;
+      case command_color:
+        batch->background_color = step_background_color(batch->background_color, command.increment);
+        break;
+      case command_size:
+        if (command.width > max_background_size || command.height > max_background_size)
+        {
+          return false;
+        }
+        batch->width = command.width;
+        batch->height = command.height;
+        break;
+      case command_entities:
+        // Each list replaces the one before, only the last one is decoded
+        entities = command.entities;
+        batch->entities = true;
+        batch->num_entities = command.num_entities;
+        break;
+      case command_draw:
+        // Only the newest request is rendered, like draw_background calls coming in faster than frames
+        batch->request = (struct render_request){command.cycle_time, command.x_offset, command.y_offset, 0, true};
+        break;
+    }
+  }
+  if (!command_reader_done(&reader))
+  {
+    return false;
+  }
+  if (!batch->entities)
+  {
+    return true;
+  }
+
+  // set_entities copies into room made here, so applying the batch cannot run out of memory
+  if (batch->num_entities > context.command_entities_capacity)
+  {
+    struct entity *decoded = realloc(context.command_entities, batch->num_entities * sizeof(struct entity));
+    if (decoded == NULL)
+    {
+      return false;
+    }
+    context.command_entities = decoded;
+    context.command_entities_capacity = batch->num_entities;
+  }
+  if (!reserve_entities(batch->num_entities))
+  {
+    return false;
+  }
+  for (uint32_t i = 0; i < batch->num_entities; i++)
   {
-    context.image_threads[i].settings.config = context.background.config;
-    context.image_threads[i].settings.cycle_time = cycle_time;
-    context.image_threads[i].settings.x_offset = x_offset;
-    context.image_threads[i].settings.y_offset = y_offset;
-    context.image_threads[i].settings.start_row = i * context.background.height / context.num_image_threads;
-    context.image_threads[i].settings.end_row = (i + 1) * context.background.height / context.num_image_threads;
+    command_entity(entities, i, &context.command_entities[i]);
+  }
+  return true;
+}
 
-    thrd_create(&context.image_threads[i].thread, image_thread_entry_point, &context.image_threads[i].settings);
+draw_status apply_commands(const struct command_batch *batch)
+{
+  bool changed = context.background.config != batch->config || context.background.width != batch->width ||
+                 context.background.height != batch->height;
+  context.background.config = batch->config;
+  context.background.width = batch->width;
+  context.background.height = batch->height;
+  context.colors.background_color = batch->background_color;
+  if (batch->entities)
+  {
+    set_entities(context.command_entities, batch->num_entities);
   }
 
-  for (int i = 0; i < context.num_image_threads; i++)
+  if (!batch->request.valid && !(changed && context.request.valid))
+  {
+    return draw_unchanged;
+  }
+  if (batch->request.valid)
   {
-    thrd_join(context.image_threads[i].thread, NULL);
+    context.request = batch->request;
   }
-  
-  context.frame_callback(context.background.width, context.background.height, context.background.width * context.background.height * sizeof(struct rgba), context.background.pixels);
+  context.request.requested_nanoseconds = monotonic_nanoseconds();
+  return render_latest_request();
 }
 
-void image_thread_entry_point(struct image_settings *settings)
+struct rgba step_background_color(struct rgba color, int increment)
+{
+  if (color.r + increment >= 0 && color.r + increment <= 255)
+  {
+    color.r += increment;
+  }
+  if (color.g + increment >= 0 && color.g + increment <= 255)
+  {
+    color.g += increment;
+  }
+  if (color.b + increment >= 0 && color.b + increment <= 255)
+  {
+    color.b += increment;
+  }
+  return color;
+}
+
+void create_context_mutex(void)
+{
+  context.mutex_ready = mtx_init(&context.mutex, mtx_plain | mtx_recursive) == thrd_success;
+}
+
+void lock_context(void)
 {
-  configuration config = settings->config;
-  switch (config) 
+  // Calls made before the first initialize find the mutex made all the same
+  call_once(&context_mutex_once, create_context_mutex);
+  if (context.mutex_ready)
   {
-    case grid: grid_configuration(settings); break;
-    case wave: wave_configuration(settings); break;
-    default: break;
+    mtx_lock(&context.mutex);
   }
 }
 
-void grid_configuration(struct image_settings *settings)
+void unlock_context(void)
+{
+  if (context.mutex_ready)
+  {
+    mtx_unlock(&context.mutex);
+  }
+}
+
+draw_status render_background(uint64_t cycle_time, int64_t x_offset, int64_t y_offset)
+{
+  // Kept even when no frame can start now, whatever is rendered next starts from the newest parameters
+  context.request = (struct render_request){cycle_time, x_offset, y_offset, monotonic_nanoseconds(), true};
+  return render_latest_request();
+}
+
+draw_status render_latest_request(void)
 {
-  int square_dash_size = square_size / 3;
-  int total_x_offset = settings->x_offset + square_size / 2;
-  int total_y_offset = settings->y_offset + square_size / 2;
+  if (context.pool == NULL || context.scheduler == NULL || context.framebuffers == NULL || context.backgrounds == NULL || context.frame_stats == NULL)
+  {
+    return draw_deferred;
+  }
+  struct render_request request = context.request;
+  request.cycle_time = cycle_phase(request.cycle_time);
+  struct frame_inputs inputs = request_inputs(&request);
+
+  if (context.geometry_callback != NULL)
+  {
+    return render_geometry(&request, inputs);
+  }
 
-  for (int y = settings->start_row; y < settings->end_row; y++) 
+  if (context.render_mode == render_async)
   {
-    int true_y = abs(y - total_y_offset) ; 
-    bool horizontal_line = true_y % square_size >= 0 && true_y % square_size < square_stroke_thickness;
-    bool vertical_space = (true_y + square_dash_size / 4) % square_dash_size >= 0 && (true_y + square_dash_size / 4) % square_dash_size < square_dash_size / 2;
-    for (int x = 0; x < context.background.width; x++)
+    // Hand out the newest finished frame, then render the next one while it is on screen
+    take_finished_frame();
+    // The frame in flight, or the one just handed out, already shows what was asked for
+    if (context.started_inputs_valid && frame_inputs_equal(context.started_inputs, inputs))
+    {
+      warm_next_frame();
+      return draw_unchanged;
+    }
+
+    if (worker_pool_busy(context.pool))
     {
-      int true_x = abs(x - total_x_offset) ;
-      bool vertical_line = true_x % square_size >= 0 && true_x % square_size < square_stroke_thickness;
-      bool horizontal_space = (true_x + square_dash_size / 4) % square_dash_size >= 0 && (true_x + square_dash_size / 4) % square_dash_size < square_dash_size / 2;
-      if ((horizontal_line && horizontal_space) || (vertical_line && vertical_space))
+      if (context.warming_in_flight)
       {
-        context.background.pixels[y * context.background.width + x] = context.colors.line_color;
+        // Warming only gets the time no request needs, the frame it was on is warmed again later
+        framebuffer_supersede(context.framebuffers);
+        worker_pool_wait(context.pool);
       }
       else
       {
-        context.background.pixels[y * context.background.width + x] = context.colors.background_color;
+        // Frames slower than the requests coming in would never be seen if every one of them was given up
+        if (atomic_load(&context.last_frame_abandoned))
+        {
+          return draw_deferred;
+        }
+        // The workers stop at their next tile, so waiting for them takes about a tile
+        framebuffer_supersede(context.framebuffers);
+        context.started_inputs_valid = false;
+        worker_pool_wait(context.pool);
       }
+      // Every tile had been handed out before the request came in
+      take_finished_frame();
+    }
+    struct framebuffer *framebuffer = framebuffer_acquire(context.framebuffers);
+    if (framebuffer == NULL)
+    {
+      atomic_fetch_add(&context.framebuffers->dropped_frames, 1);
+      return draw_deferred;
+    }
+    if (show_cached_frame(framebuffer, &request, inputs))
+    {
+      context.started_inputs = inputs;
+      context.started_inputs_valid = true;
+      warm_next_frame();
+      return draw_started;
+    }
+    framebuffer->inputs = inputs;
+    framebuffer->warming = false;
+    if (!prepare_frame(framebuffer, request.requested_nanoseconds, request.cycle_time, request.x_offset, request.y_offset))
+    {
+      atomic_store(&framebuffer->state, framebuffer_free);
+      return draw_deferred;
+    }
+    context.started_inputs = inputs;
+    context.started_inputs_valid = true;
+    context.warming_in_flight = false;
+    worker_pool_submit(context.pool, image_job, framebuffer, render_frame_done);
+    return draw_started;
+  }
+
+  // Nothing to render, and nothing to decode and repaint on the other side
+  if (context.started_inputs_valid && frame_inputs_equal(context.started_inputs, inputs))
+  {
+    warm_next_frame();
+    return draw_unchanged;
+  }
+  struct framebuffer *framebuffer = framebuffer_acquire(context.framebuffers);
+  if (framebuffer == NULL)
+  {
+    // Every buffer is still held by the consumer
+    atomic_fetch_add(&context.framebuffers->dropped_frames, 1);
+    return draw_deferred;
+  }
+  if (show_cached_frame(framebuffer, &request, inputs))
+  {
+    context.started_inputs = inputs;
+    context.started_inputs_valid = true;
+    warm_next_frame();
+    return draw_started;
+  }
+  framebuffer->inputs = inputs;
+  framebuffer->warming = false;
+  if (!prepare_frame(framebuffer, request.requested_nanoseconds, request.cycle_time, request.x_offset, request.y_offset))
+  {
+    atomic_store(&framebuffer->state, framebuffer_free);
+    return draw_deferred;
+  }
+  uint64_t wait_started = monotonic_nanoseconds();
+  uint64_t trace_started = trace_begin();
+  worker_pool_run(context.pool, image_job, framebuffer);
+  trace_end("wait_for_workers", trace_started, "frame_id", framebuffer->id);
+  framebuffer->stats.wait_nanoseconds = monotonic_nanoseconds() - wait_started;
+  bool abandoned = atomic_load(&framebuffer->abandoned);
+  atomic_store(&context.last_frame_abandoned, abandoned);
+  if (abandoned)
+  {
+    framebuffer_abandon(context.framebuffers, framebuffer);
+    context.started_inputs_valid = false;
+    return draw_deferred;
+  }
+  context.started_inputs = inputs;
+  context.started_inputs_valid = true;
+  framebuffer->rendered_nanoseconds = monotonic_nanoseconds();
+  record_render_time(framebuffer);
+  present_frame(framebuffer);
+  return draw_started;
+}
+
+draw_status render_geometry(const struct render_request *request, struct frame_inputs inputs)
+{
+  // Never warms the frame cache, the workers stay idle and out of the background's state.
+  // Entities are only drawn into pixels, a change to them alone leaves the geometry as it is.
+  inputs.entities_version = 0;
+  if (context.started_inputs_valid && frame_inputs_equal(context.started_inputs, inputs))
+  {
+    return draw_unchanged;
+  }
+  if (background_find(context.backgrounds, context.background.config)->row_spans == NULL)
+  {
+    return draw_deferred;
+  }
+  struct geometry_buffer *buffer = geometry_acquire(context.geometry, context.framebuffers->next_id);
+  if (buffer == NULL)
+  {
+    atomic_fetch_add(&context.framebuffers->dropped_frames, 1);
+    return draw_deferred;
+  }
+  // Ids come from the same sequence as the pixel frames, the consumer can tell which is newer across a switch
+  context.framebuffers->next_id++;
+
+  uint64_t trace_started = trace_begin();
+  struct frame_stats stats = {0};
+  stats.frame_id = buffer->id;
+  stats.config = context.background.config;
+  stats.requested_nanoseconds = request->requested_nanoseconds;
+  stats.render_started_nanoseconds = monotonic_nanoseconds();
+
+  // Geometry costs the same at any resolution, it is always built at the output size
+  double ratio = context.render_scale.device_pixel_ratio;
+  struct image_settings settings = {0};
+  settings.config = context.background.config;
+  settings.cycle_time = request->cycle_time;
+  settings.x_offset = request->x_offset;
+  settings.y_offset = request->y_offset;
+  settings.width = settings.output_width = ratio == 1 ? context.background.width : (uint64_t)ceil(context.background.width * ratio);
+  settings.height = settings.output_height = ratio == 1 ? context.background.height : (uint64_t)ceil(context.background.height * ratio);
+  settings.end_row = settings.height;
+  settings.sample_scale = 1 / ratio;
+  settings.logical_width = context.background.width;
+  settings.colors = context.colors;
+  if (!background_prepare(context.backgrounds, &settings) || !geometry_build(buffer, context.backgrounds, &settings))
+  {
+    geometry_release(context.geometry, buffer->id);
+    return draw_deferred;
+  }
+  context.started_inputs = inputs;
+  context.started_inputs_valid = true;
+
+  // The caller built the whole frame, it is recorded as the one worker
+  uint64_t bytes = buffer->frame.num_vertices * 2 * sizeof(float);
+  stats.presented_nanoseconds = monotonic_nanoseconds();
+  stats.num_workers = 1;
+  stats.workers[0] = (struct worker_timing){stats.render_started_nanoseconds, stats.presented_nanoseconds, 0, bytes, 0, {0}, -1, -1};
+  stats.bytes_written = bytes;
+  uint64_t dropped_frames = atomic_load(&context.framebuffers->dropped_frames);
+  stats.dropped_frames = dropped_frames - context.frame_stats->dropped_frames;
+  context.frame_stats->dropped_frames = dropped_frames;
+  trace_end("build_geometry", trace_started, "frame_id", stats.frame_id);
+
+  uint64_t callback_started = trace_begin();
+  context.geometry_callback(stats.frame_id, &buffer->frame);
+  trace_end("geometry_callback", callback_started, "frame_id", stats.frame_id);
+  stats.callback_nanoseconds = monotonic_nanoseconds() - stats.presented_nanoseconds;
+  frame_stats_publish(context.frame_stats, &stats);
+  return draw_started;
+}
+
+struct frame_inputs request_inputs(const struct render_request *request)
+{
+  uint32_t depends_on = background_find(context.backgrounds, context.background.config)->inputs;
+  struct frame_inputs inputs = {context.background.config, context.background.width, context.background.height, context.render_scale.device_pixel_ratio,
+                                context.render_scale.scale_shift, context.colors.background_color, context.colors.line_color, 0, 0, 0,
+                                context.entities_version};
+  if (depends_on & background_input_cycle_time)
+  {
+    inputs.cycle_time = request->cycle_time;
+  }
+  if (depends_on & background_input_x_offset)
+  {
+    inputs.x_offset = request->x_offset;
+  }
+  if (depends_on & background_input_y_offset)
+  {
+    inputs.y_offset = request->y_offset;
+  }
+  return inputs;
+}
+
+uint64_t cycle_phase(uint64_t cycle_time)
+{
+  const struct frame_cache_settings *settings = &context.frame_cache_settings;
+  if (settings->cycle_period > 0)
+  {
+    cycle_time %= settings->cycle_period;
+  }
+  if (settings->time_quantum > 1)
+  {
+    cycle_time -= cycle_time % settings->time_quantum;
+  }
+  return cycle_time;
+}
+
+void take_finished_frame(void)
+{
+  struct framebuffer *latest = framebuffer_take_latest(context.framebuffers);
+  if (latest == NULL)
+  {
+    return;
+  }
+  if (!latest->warming)
+  {
+    // Taken before the next frame is prepared, so the scale it picks is in that frame's key
+    record_render_time(latest);
+    present_frame(latest);
+    return;
+  }
+
+  // Nobody waits for a warmed frame, it only goes into the cache and the next one is due
+  if (context.frame_cache != NULL && context.warm_frames_left > 0)
+  {
+    if (!frame_cache_store(context.frame_cache, &latest->inputs, latest))
+    {
+      context.warm_frames_left = 0;
+    }
+    else if (frame_inputs_equal(latest->inputs, warm_request_inputs()))
+    {
+      context.warm_request.cycle_time += warm_step();
+      context.warm_frames_left--;
+    }
+  }
+  atomic_store(&latest->state, framebuffer_free);
+}
+
+bool show_cached_frame(struct framebuffer *framebuffer, const struct render_request *request, struct frame_inputs inputs)
+{
+  if (context.frame_cache == NULL)
+  {
+    return false;
+  }
+  uint64_t trace_started = trace_begin();
+  struct frame_cache_entry *entry = frame_cache_find(context.frame_cache, &inputs, true);
+  if (entry == NULL || !framebuffer_reserve(context.framebuffers, framebuffer, entry->key.width, entry->key.height))
+  {
+    return false;
+  }
+  frame_cache_load(entry, framebuffer);
+  // Cached frames never hold entities, whatever the buffer had drawn is gone with its pixels
+  framebuffer->num_entities = 0;
+  framebuffer->inputs = inputs;
+  framebuffer->warming = false;
+  compute_frame_shift(framebuffer);
+  framebuffer->stats.requested_nanoseconds = request->requested_nanoseconds;
+  framebuffer->stats.render_started_nanoseconds = monotonic_nanoseconds();
+  framebuffer->stats.wait_nanoseconds = 0;
+  framebuffer->stats.num_workers = 0;
+  framebuffer->stats.config = inputs.config;
+  framebuffer->stats.cached = true;
+  trace_end("load_cached_frame", trace_started, "frame_id", framebuffer->id);
+  present_frame(framebuffer);
+  return true;
+}
+
+void warm_next_frame(void)
+{
+  if (context.frame_cache == NULL || context.warm_frames_left == 0 || worker_pool_busy(context.pool))
+  {
+    return;
+  }
+  // Frames cached in the meantime, by a request or an earlier warming, are skipped
+  struct frame_inputs inputs = warm_request_inputs();
+  while (frame_cache_find(context.frame_cache, &inputs, false) != NULL)
+  {
+    context.warm_request.cycle_time += warm_step();
+    if (--context.warm_frames_left == 0)
+    {
+      return;
     }
+    inputs = warm_request_inputs();
+  }
+  struct render_request request = context.warm_request;
+  request.cycle_time = cycle_phase(request.cycle_time);
+
+  struct framebuffer *framebuffer = framebuffer_acquire(context.framebuffers);
+  if (framebuffer == NULL)
+  {
+    return;
+  }
+  framebuffer->inputs = inputs;
+  framebuffer->warming = true;
+  if (!prepare_frame(framebuffer, monotonic_nanoseconds(), request.cycle_time, request.x_offset, request.y_offset))
+  {
+    atomic_store(&framebuffer->state, framebuffer_free);
+    return;
   }
+  if (context.render_mode == render_async)
+  {
+    context.warming_in_flight = true;
+    worker_pool_submit(context.pool, image_job, framebuffer, render_frame_done);
+    return;
+  }
+
+  // Synchronously the caller waits for it, which is still no longer than a frame it would have had to render
+  worker_pool_run(context.pool, image_job, framebuffer);
+  framebuffer_publish(context.framebuffers, framebuffer);
+  take_finished_frame();
+}
+
+struct frame_inputs warm_request_inputs(void)
+{
+  struct render_request request = context.warm_request;
+  request.cycle_time = cycle_phase(request.cycle_time);
+  // Warmed frames are the bare background, whatever entities there are
+  struct frame_inputs inputs = request_inputs(&request);
+  inputs.entities_version = 0;
+  return inputs;
+}
+
+uint64_t warm_step(void)
+{
+  return context.frame_cache_settings.time_quantum > 1 ? context.frame_cache_settings.time_quantum : 1;
 }
 
-void wave_configuration(struct image_settings *settings)
+bool prepare_frame(struct framebuffer *framebuffer, uint64_t requested, uint64_t cycle_time, int64_t x_offset, int64_t y_offset)
 {
-  double offset = 100;
-  double amplitude = 30;
-  double time = settings->cycle_time / 100.0;
+  uint64_t trace_started = trace_begin();
+  // Frames come out at the logical size times the device pixel ratio, and are rendered at a fraction of it
+  double ratio = context.render_scale.device_pixel_ratio;
+  uint64_t output_width = ratio == 1 ? context.background.width : (uint64_t)ceil(context.background.width * ratio);
+  uint64_t output_height = ratio == 1 ? context.background.height : (uint64_t)ceil(context.background.height * ratio);
+  if (!framebuffer_reserve(context.framebuffers, framebuffer, output_width, output_height))
+  {
+    return false;
+  }
+  uint32_t scale_shift = context.render_scale.scale_shift;
+  uint64_t render_width = (output_width + (1 << scale_shift) - 1) >> scale_shift;
+  uint64_t render_height = (output_height + (1 << scale_shift) - 1) >> scale_shift;
+
+  context.frame_settings.config = context.background.config;
+  context.frame_settings.cycle_time = cycle_time;
+  context.frame_settings.x_offset = x_offset;
+  context.frame_settings.y_offset = y_offset;
+  context.frame_settings.start_row = 0;
+  context.frame_settings.end_row = render_height;
+  context.frame_settings.width = render_width;
+  context.frame_settings.height = render_height;
+  context.frame_settings.output_width = framebuffer->width;
+  context.frame_settings.output_height = framebuffer->height;
+  context.frame_settings.stride = framebuffer->stride;
+  context.frame_settings.scale_shift = scale_shift;
+  context.frame_settings.sample_scale = (1 << scale_shift) / ratio;
+  context.frame_settings.logical_width = context.background.width;
+  context.frame_settings.colors = context.colors;
+  context.frame_settings.pixels = framebuffer->pixels;
+  context.frame_settings.rows = framebuffer->rows;
+  context.frame_settings.indices = framebuffer->indices;
 
-  double angle = sin(time * 0.5) * 0.5;         // Oscillates between -0.5 and 0.5
-  double frequency = 0.01 + 0.005 * sin(time);  // Oscillates between 0.005 and 0.015
-  double scroll =  offset + fmod(settings->cycle_time * 0.05, context.background.width); // Smooth horizontal scroll
+  // Runs while no worker is rendering, whatever the background caches is only read by the tiles of this frame
+  if (!background_prepare(context.backgrounds, &context.frame_settings))
+  {
+    return false;
+  }
+
+  // Entities are placed once for every tile to draw its share of them, warming frames stay the bare background for the cache
+  if (!compositor_place(framebuffer, context.entities, framebuffer->warming ? 0 : context.num_entities, ratio))
+  {
+    return false;
+  }
 
-  struct range ranges[] = {
-        {-80, 0.5},
-        {-60, 1.0},
-        {-40, 2.0},
-        {-20, 3.0},
-        {0, 4.0},
-        {20, 3.0},
-        {40, 2.0},
-        {60, 1.0},
-        {80, 1.0}
-  };
+  // Only pixels that differ from what the buffer already holds are written when nothing else changed
+  struct frame_key key = {context.frame_settings.config, framebuffer->width, framebuffer->height, render_width, render_height, scale_shift,
+                          context.frame_settings.sample_scale, context.colors.background_color, context.colors.line_color, 0};
+  // Horizontal scrolling changes the palette indices of every row, vertical scrolling only which row is where
+  if (background_find(context.backgrounds, key.config)->inputs & background_input_x_offset)
+  {
+    key.x_offset = x_offset;
+  }
+  // The palette indices only depend on the geometry, a color change alone just expands them again
+  context.frame_settings.incremental = context.incremental && framebuffer->key_valid && frame_key_same_indices(framebuffer->key, key);
+  context.frame_settings.expand = !context.frame_settings.incremental || !frame_key_equal(framebuffer->key, key);
+  framebuffer->key = key;
+  framebuffer->key_valid = true;
 
-  for (int y = settings->start_row; y < settings->end_row; y++)
+  context.frame_settings.strip_rows_start = 0;
+  context.frame_settings.strip_rows_end = render_height;
+  context.frame_settings.strip_columns_start = 0;
+  context.frame_settings.strip_columns_end = 0;
+  compute_frame_shift(framebuffer);
+  struct frame_shift *shift = &framebuffer->shift;
+  // What moved into view is all there is to render, warming frames are kept whole for the cache
+  shift->strips_only = context.strip_rendering && shift->exact && !framebuffer->warming && llabs(shift->dx) < (int64_t)framebuffer->width &&
+                       llabs(shift->dy) < (int64_t)framebuffer->height;
+  if (shift->strips_only)
   {
-    for (int x = 0; x < context.background.width; x++)
+    // Rendered pixels covering any output pixel of a strip, exact shifts are whole rendered pixels
+    // Both shifts are smaller than the frame, so the strips are worked out from their magnitudes
+    int64_t dx = shift->dx, dy = shift->dy;
+    uint64_t rows = (uint64_t)llabs(dy), columns = (uint64_t)llabs(dx);
+    context.frame_settings.strip_rows_start = dy < 0 ? (framebuffer->height - rows) >> scale_shift : 0;
+    context.frame_settings.strip_rows_end = dy > 0 ? rows >> scale_shift : dy < 0 ? render_height : 0;
+    context.frame_settings.strip_columns_start = dx < 0 ? (framebuffer->width - columns) >> scale_shift : 0;
+    context.frame_settings.strip_columns_end = dx > 0 ? columns >> scale_shift : dx < 0 ? render_width : 0;
+    context.frame_settings.incremental = false;
+    context.frame_settings.expand = true;
+    // Only rows holding a strip are rendered when the frame moved vertically alone
+    if (dx == 0)
     {
-      double wave_x = offset + scroll + angle * y + amplitude * sin(y * frequency);
-      
-      bool is_index_in_any_range = false;
-      int num_ranges = sizeof(ranges) / sizeof(ranges[0]);
-      for (int range_index = 0; range_index < num_ranges; range_index++)
-      {
-        if (is_index_in_range(x, wave_x, ranges[range_index])) {
-          is_index_in_any_range = true;
-          break;
-        }
-      }
+      context.frame_settings.start_row = context.frame_settings.strip_rows_start;
+      context.frame_settings.end_row = context.frame_settings.strip_rows_end;
+    }
+    // The rest of the buffer holds whatever frame it had before, the next frame in it is rendered in full
+    framebuffer->key_valid = false;
+  }
 
-      if (is_index_in_any_range)
-      {
-        context.background.pixels[y * context.background.width + x] = context.colors.line_color;
-      }
-      else
-      {
-        context.background.pixels[y * context.background.width + x] = context.colors.background_color;
-      }
+  uint64_t num_rows = context.frame_settings.end_row - context.frame_settings.start_row;
+  tile_scheduler_reset(context.scheduler, (num_rows + tile_rows - 1) / tile_rows);
+  framebuffer->stats.requested_nanoseconds = requested;
+  framebuffer->stats.wait_nanoseconds = 0;
+  framebuffer->stats.num_workers = context.num_image_threads;
+  framebuffer->stats.config = context.frame_settings.config;
+  framebuffer->stats.cached = false;
+  framebuffer->stats.render_started_nanoseconds = monotonic_nanoseconds();
+  trace_end("prepare_frame", trace_started, "frame_id", framebuffer->id);
+  return true;
+}
+
+void compute_frame_shift(struct framebuffer *framebuffer)
+{
+  struct frame_shift *shift = &framebuffer->shift;
+  memset(shift, 0, sizeof(struct frame_shift));
+  const struct frame_inputs *from = &context.presented_inputs, *to = &framebuffer->inputs;
+  if (!context.presented_valid || from->config != to->config || from->width != to->width || from->height != to->height ||
+      from->device_pixel_ratio != to->device_pixel_ratio || from->scale_shift != to->scale_shift || !rgba_equal(from->background_color, to->background_color) ||
+      !rgba_equal(from->line_color, to->line_color) || from->entities_version != 0 || to->entities_version != 0)
+  {
+    return;
+  }
+
+  double dx, dy;
+  bool moved_only = background_find(context.backgrounds, to->config)->shift(from, to, &dx, &dy);
+  // Logical pixels become rendered pixels, then whole output pixels
+  double sample_scale = (1 << to->scale_shift) / to->device_pixel_ratio;
+  double render_dx = round(dx / sample_scale), render_dy = round(dy / sample_scale);
+  shift->valid = true;
+  shift->base_frame_id = context.presented_frame_id;
+  shift->dx = (int64_t)render_dx * (1 << to->scale_shift);
+  shift->dy = (int64_t)render_dy * (1 << to->scale_shift);
+  // Rows and columns sample floor(position * scale), moving by whole rendered pixels only keeps every sample when the scale is a power of two
+  int exponent;
+  shift->exact = moved_only && frexp(sample_scale, &exponent) == 0.5 && render_dx * sample_scale == dx && render_dy * sample_scale == dy;
+
+  int64_t width = (int64_t)framebuffer->width, height = (int64_t)framebuffer->height;
+  if (llabs(shift->dx) >= width || llabs(shift->dy) >= height)
+  {
+    shift->strips[shift->num_strips++] = (struct rect){0, 0, (uint32_t)width, (uint32_t)height};
+    return;
+  }
+  if (shift->dx != 0)
+  {
+    shift->strips[shift->num_strips++] = (struct rect){shift->dx > 0 ? 0 : (uint32_t)(width + shift->dx), 0, (uint32_t)llabs(shift->dx), (uint32_t)height};
+  }
+  if (shift->dy != 0)
+  {
+    shift->strips[shift->num_strips++] = (struct rect){0, shift->dy > 0 ? 0 : (uint32_t)(height + shift->dy), (uint32_t)width, (uint32_t)llabs(shift->dy)};
+  }
+}
+
+void present_frame(struct framebuffer *framebuffer)
+{
+  uint64_t trace_started = trace_begin();
+  // Kept before the consumer gets hold of the pixels, a frame of strips is not whole
+  if (context.frame_cache != NULL && !framebuffer->stats.cached && !framebuffer->shift.strips_only && framebuffer->inputs.entities_version == 0)
+  {
+    frame_cache_store(context.frame_cache, &framebuffer->inputs, framebuffer);
+  }
+  context.presented_inputs = framebuffer->inputs;
+  context.presented_frame_id = framebuffer->id;
+  context.presented_valid = true;
+  compute_dirty_rects(framebuffer);
+  framebuffer_display(framebuffer);
+
+  // Copied first, the consumer may hand the buffer back from within the callback
+  struct frame_stats *stats = &framebuffer->stats;
+  stats->frame_id = framebuffer->id;
+  stats->bytes_written = 0;
+  for (uint32_t i = 0; i < stats->num_workers; i++)
+  {
+    stats->bytes_written += stats->workers[i].bytes_written;
+  }
+  uint64_t dropped_frames = atomic_load(&context.framebuffers->dropped_frames);
+  stats->dropped_frames = dropped_frames - context.frame_stats->dropped_frames;
+  context.frame_stats->dropped_frames = dropped_frames;
+  stats->presented_nanoseconds = monotonic_nanoseconds();
+  struct frame_stats presented = *stats;
+
+  uint64_t row_bytes = framebuffer->stride * sizeof(struct rgba);
+  uint64_t callback_started = trace_begin();
+  context.frame_callback(framebuffer->id, framebuffer->width, framebuffer->height, row_bytes, row_bytes * framebuffer->height, framebuffer->pixels);
+  trace_end("frame_callback", callback_started, "frame_id", presented.frame_id);
+  presented.callback_nanoseconds = monotonic_nanoseconds() - presented.presented_nanoseconds;
+  frame_stats_publish(context.frame_stats, &presented);
+  trace_end("present_frame", trace_started, "frame_id", presented.frame_id);
+}
+
+void render_frame_done(void *data)
+{
+  struct framebuffer *framebuffer = data;
+  uint64_t trace_started = trace_begin();
+  if (framebuffer->warming)
+  {
+    // Giving up a warming frame holds back no request, the next one may still be given up
+    if (atomic_load(&framebuffer->abandoned))
+    {
+      framebuffer->key_valid = false;
+      atomic_store(&framebuffer->state, framebuffer_free);
+      trace_end("abandon_frame", trace_started, "frame_id", framebuffer->id);
+      return;
     }
+    framebuffer_publish(context.framebuffers, framebuffer);
+    trace_end("publish_frame", trace_started, "frame_id", framebuffer->id);
+    return;
+  }
+  // Read by the caller once the pool is idle again
+  bool abandoned = atomic_load(&framebuffer->abandoned);
+  atomic_store(&context.last_frame_abandoned, abandoned);
+  if (abandoned)
+  {
+    framebuffer_abandon(context.framebuffers, framebuffer);
+    trace_end("abandon_frame", trace_started, "frame_id", framebuffer->id);
+    return;
+  }
+  // The render scale belongs to the caller, it adapts once it takes the frame
+  framebuffer->rendered_nanoseconds = monotonic_nanoseconds();
+  framebuffer_publish(context.framebuffers, framebuffer);
+  trace_end("publish_frame", trace_started, "frame_id", framebuffer->id);
+}
+
+void record_render_time(struct framebuffer *framebuffer)
+{
+  adapt_render_scale((framebuffer->rendered_nanoseconds - framebuffer->stats.render_started_nanoseconds) / 1e6);
+}
+
+void adapt_render_scale(double milliseconds)
+{
+  struct render_scale_controller *controller = &context.render_scale;
+  if (controller->budget_milliseconds <= 0)
+  {
+    return;
+  }
+
+  controller->average_milliseconds = controller->frames_at_scale == 0 ? milliseconds : controller->average_milliseconds * 0.8 + milliseconds * 0.2;
+  if (++controller->frames_at_scale < render_scale_settle_frames)
+  {
+    return;
+  }
+
+  // Each step changes the rendered pixels four times, only step back up when that would still fit with some margin
+  if (controller->average_milliseconds > controller->budget_milliseconds && controller->scale_shift < max_render_scale_shift)
+  {
+    controller->scale_shift++;
+    controller->frames_at_scale = 0;
+  }
+  else if (controller->average_milliseconds * 4 < controller->budget_milliseconds * 0.75 && controller->scale_shift > render_scale_full)
+  {
+    controller->scale_shift--;
+    controller->frames_at_scale = 0;
+  }
+}
+
+uint64_t monotonic_nanoseconds(void)
+{
+#if _WIN32
+  LARGE_INTEGER counter, frequency;
+  QueryPerformanceCounter(&counter);
+  QueryPerformanceFrequency(&frequency);
+  return (uint64_t)((double)counter.QuadPart * 1e9 / frequency.QuadPart);
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+void release_frame(uint64_t frame_id)
+{
+  // Frames come back from any thread, even after shutdown freed the rings
+  lock_context();
+  bool released = context.framebuffers != NULL && framebuffer_release(context.framebuffers, frame_id);
+  if (!released && context.geometry != NULL)
+  {
+    geometry_release(context.geometry, frame_id);
   }
+  unlock_context();
+}
+
+void set_incremental_rendering(uint8_t enabled)
+{
+  lock_context();
+  context.incremental = enabled;
+  unlock_context();
+}
+
+void set_strip_rendering(uint8_t enabled)
+{
+  lock_context();
+  context.strip_rendering = enabled;
+  unlock_context();
+}
+
+bool get_frame_shift(uint64_t frame_id, struct frame_shift *shift)
+{
+  lock_context();
+  struct framebuffer *framebuffer = context.framebuffers != NULL ? framebuffer_find_displayed(context.framebuffers, frame_id) : NULL;
+  if (framebuffer != NULL)
+  {
+    *shift = framebuffer->shift;
+  }
+  unlock_context();
+  return framebuffer != NULL;
+}
+
+uint32_t get_dirty_rects(uint64_t frame_id, struct rect *rects, uint32_t capacity)
+{
+  lock_context();
+  struct framebuffer *framebuffer = context.framebuffers != NULL ? framebuffer_find_displayed(context.framebuffers, frame_id) : NULL;
+  uint32_t num_dirty_rects = framebuffer != NULL ? framebuffer->num_dirty_rects : 0;
+  for (uint32_t i = 0; i < num_dirty_rects && i < capacity; i++)
+  {
+    rects[i] = framebuffer->dirty_rects[i];
+  }
+  unlock_context();
+  return num_dirty_rects;
+}
+
+void set_geometry_output(geometry_callback callback)
+{
+  lock_context();
+  // Geometry is built from the backgrounds' state on the caller's thread, no worker may be using it
+  if (context.pool != NULL)
+  {
+    worker_pool_wait(context.pool);
+  }
+  if (callback != NULL && context.geometry == NULL)
+  {
+    context.geometry = malloc(sizeof(struct geometry_ring));
+    if (context.geometry == NULL)
+    {
+      unlock_context();
+      return;
+    }
+    geometry_ring_create(context.geometry);
+  }
+
+  if (context.framebuffers != NULL)
+  {
+    // A pixel frame finished ahead of time is stale once the other output took over
+    struct framebuffer *latest = framebuffer_take_latest(context.framebuffers);
+    if (latest != NULL)
+    {
+      atomic_store(&latest->state, framebuffer_free);
+    }
+    // Dirty rectangles and shifts are relative to a pixel frame the consumer no longer shows
+    context.framebuffers->displayed_valid = false;
+  }
+  context.presented_valid = false;
+  context.started_inputs_valid = false;
+  context.warming_in_flight = false;
+  context.geometry_callback = callback;
+  unlock_context();
+}
+
+bool set_entities(const struct entity *entities, uint32_t num_entities)
+{
+  lock_context();
+  // The same entities again keep the version, so an unchanged scene is still answered with draw_unchanged
+  bool same = num_entities == context.num_entities;
+  for (uint32_t i = 0; i < num_entities && same; i++)
+  {
+    same = compositor_entity_equal(&entities[i], &context.entities[i]);
+  }
+  if (same)
+  {
+    unlock_context();
+    return true;
+  }
+
+  if (!reserve_entities(num_entities))
+  {
+    unlock_context();
+    return false;
+  }
+  // Workers draw from the copy each frame placed for itself, the list can change while they render
+  if (num_entities > 0)
+  {
+    memcpy(context.entities, entities, num_entities * sizeof(struct entity));
+  }
+  context.num_entities = num_entities;
+  context.entities_version = num_entities > 0 ? ++context.entities_generation : 0;
+  unlock_context();
+  return true;
+}
+
+bool reserve_entities(uint32_t num_entities)
+{
+  if (num_entities > context.entities_capacity)
+  {
+    struct entity *copy = realloc(context.entities, num_entities * sizeof(struct entity));
+    if (copy == NULL)
+    {
+      return false;
+    }
+    context.entities = copy;
+    context.entities_capacity = num_entities;
+  }
+  return true;
+}
+
+bool get_frame_indices(uint64_t frame_id, struct index_plane *plane)
+{
+  lock_context();
+  struct framebuffer *framebuffer = context.framebuffers != NULL ? framebuffer_find_displayed(context.framebuffers, frame_id) : NULL;
+  if (framebuffer == NULL)
+  {
+    unlock_context();
+    return false;
+  }
+  plane->indices = framebuffer->indices;
+  plane->width = framebuffer->key.render_width;
+  plane->height = framebuffer->key.render_height;
+  plane->stride = framebuffer->stride;
+  plane->palette[palette_background] = framebuffer->key.background_color;
+  plane->palette[palette_line] = framebuffer->key.line_color;
+  unlock_context();
+  return true;
+}
+
+void set_render_scale(uint8_t scale_byte)
+{
+  lock_context();
+  context.render_scale.scale_shift = scale_byte <= max_render_scale_shift ? scale_byte : max_render_scale_shift;
+  context.render_scale.frames_at_scale = 0;
+  unlock_context();
+}
+
+uint8_t get_render_scale(void)
+{
+  lock_context();
+  uint8_t scale_shift = context.render_scale.scale_shift;
+  unlock_context();
+  return scale_shift;
+}
+
+void set_device_pixel_ratio(double ratio)
+{
+  lock_context();
+  context.render_scale.device_pixel_ratio = ratio > max_device_pixel_ratio ? max_device_pixel_ratio : ratio > 0 ? ratio : 1;
+  unlock_context();
+}
+
+void set_frame_budget(double milliseconds)
+{
+  lock_context();
+  context.render_scale.budget_milliseconds = milliseconds;
+  context.render_scale.frames_at_scale = 0;
+  unlock_context();
+}
+
+uint32_t get_frame_stats(struct frame_stats *stats, uint32_t capacity)
+{
+  // Left out of the lock, a reader never waits for the frame being rendered
+  return frame_stats_read(&presented_frame_stats, stats, capacity);
+}
+
+struct framebuffer_memory get_framebuffer_memory(void)
+{
+  lock_context();
+  struct framebuffer_memory memory = {0, 0};
+  if (context.framebuffers != NULL)
+  {
+    memory.current_bytes = atomic_load(&context.framebuffers->allocated_bytes);
+    memory.peak_bytes = atomic_load(&context.framebuffers->peak_allocated_bytes);
+  }
+  unlock_context();
+  return memory;
+}
+
+void set_render_mode(uint8_t mode_byte)
+{
+  lock_context();
+  if (context.pool != NULL)
+  {
+    worker_pool_wait(context.pool);
+  }
+
+  // A frame finished ahead of time is not shown once rendering goes back to being synchronous
+  if (mode_byte == render_sync && context.framebuffers != NULL)
+  {
+    struct framebuffer *latest = framebuffer_take_latest(context.framebuffers);
+    if (latest != NULL)
+    {
+      atomic_store(&latest->state, framebuffer_free);
+    }
+    // The frame started last may be the one just dropped, the same request has to render again
+    context.started_inputs_valid = false;
+    context.warming_in_flight = false;
+  }
+  context.render_mode = mode_byte;
+  unlock_context();
+}
+
+void set_frame_cache(const struct frame_cache_settings *settings)
+{
+  lock_context();
+  // A warming frame may still be in flight, it is only stored once taken by the caller
+  if (context.pool != NULL)
+  {
+    worker_pool_wait(context.pool);
+  }
+  context.frame_cache_settings = *settings;
+  if (settings->budget_bytes == 0)
+  {
+    if (context.frame_cache != NULL)
+    {
+      frame_cache_destroy(context.frame_cache);
+      free(context.frame_cache);
+      context.frame_cache = NULL;
+    }
+    context.warm_frames_left = 0;
+    unlock_context();
+    return;
+  }
+
+  if (context.frame_cache == NULL)
+  {
+    context.frame_cache = malloc(sizeof(struct frame_cache));
+    if (context.frame_cache != NULL)
+    {
+      frame_cache_create(context.frame_cache, settings->budget_bytes);
+    }
+  }
+  else
+  {
+    frame_cache_set_budget(context.frame_cache, settings->budget_bytes);
+  }
+  unlock_context();
+}
+
+uint32_t warm_frame_cache(uint64_t cycle_time, uint32_t num_frames, int64_t x_offset, int64_t y_offset)
+{
+  lock_context();
+  context.warm_request = (struct render_request){cycle_time, x_offset, y_offset, 0, true};
+  context.warm_frames_left = context.frame_cache != NULL && context.backgrounds != NULL ? num_frames : 0;
+  if (context.warm_frames_left == 0)
+  {
+    unlock_context();
+    return 0;
+  }
+
+  // Steps the background does not depend on come out as the frame before them and are only counted once
+  uint32_t missing = 0;
+  struct frame_inputs previous;
+  for (uint32_t i = 0; i < num_frames; i++)
+  {
+    struct frame_inputs inputs = warm_request_inputs();
+    context.warm_request.cycle_time += warm_step();
+    missing += (i == 0 || !frame_inputs_equal(previous, inputs)) && frame_cache_find(context.frame_cache, &inputs, false) == NULL;
+    previous = inputs;
+  }
+  context.warm_request.cycle_time = cycle_time;
+  unlock_context();
+  return missing;
+}
+
+struct frame_cache_stats get_frame_cache_stats(void)
+{
+  lock_context();
+  struct frame_cache_stats stats = {0, 0, 0, context.warm_frames_left, 0, 0, 0};
+  if (context.frame_cache != NULL)
+  {
+    stats.budget_bytes = context.frame_cache->budget_bytes;
+    stats.used_bytes = context.frame_cache->used_bytes;
+    stats.num_frames = context.frame_cache->num_entries;
+    stats.hits = context.frame_cache->hits;
+    stats.misses = context.frame_cache->misses;
+    stats.evictions = context.frame_cache->evictions;
+  }
+  unlock_context();
+  return stats;
+}
+
+void set_tracing(uint8_t enabled)
+{
+  lock_context();
+  if (enabled)
+  {
+    trace_start();
+  }
+  else
+  {
+    trace_stop();
+  }
+  unlock_context();
+}
+
+bool write_trace(const char *path)
+{
+  return trace_write(path);
+}
+
+uint64_t trace_clock(void)
+{
+  return monotonic_nanoseconds();
+}
+
+void trace_dart_event(const char *name, uint64_t start_nanoseconds, uint64_t end_nanoseconds)
+{
+  trace_record_dart(name, start_nanoseconds, end_nanoseconds);
+}
+
+uint32_t set_perf_counters(uint8_t enabled)
+{
+  lock_context();
+  // Counters are only opened and closed while no worker is reading them
+  if (context.pool != NULL)
+  {
+    worker_pool_wait(context.pool);
+  }
+  if (context.perf_counters != NULL)
+  {
+    for (uint32_t i = 0; i < max_image_threads; i++)
+    {
+      perf_counters_close(&context.perf_counters[i]);
+    }
+    free(context.perf_counters);
+    context.perf_counters = NULL;
+  }
+  // What the calling thread may open, the workers are granted the same
+  uint32_t available = 0;
+  if (enabled)
+  {
+    struct perf_counters probe;
+    available = perf_counters_open(&probe);
+    perf_counters_close(&probe);
+  }
+  if (available > 0)
+  {
+    context.perf_counters = calloc(max_image_threads, sizeof(struct perf_counters));
+    available = context.perf_counters != NULL ? available : 0;
+  }
+  unlock_context();
+  return available;
+}
+
+uint8_t select_kernels(uint8_t isa_byte)
+{
+  lock_context();
+  // Tiles read the table for every row, a frame in flight would otherwise be written by two kernels
+  if (context.pool != NULL)
+  {
+    worker_pool_wait(context.pool);
+  }
+  uint8_t isa = kernels_select(isa_byte);
+  unlock_context();
+  return isa;
+}
+
+void shutdown(void)
+{
+  lock_context();
+  if (context.pool != NULL)
+  {
+    worker_pool_stop(context.pool);
+    free(context.pool);
+    context.pool = NULL;
+  }
+
+  set_perf_counters(0);
+
+  // Workers are gone, so nothing is still appending while the trace is written
+  if (context.trace_path != NULL)
+  {
+    trace_stop();
+    trace_write(context.trace_path);
+    context.trace_path = NULL;
+  }
+
+  if (context.scheduler != NULL)
+  {
+    tile_scheduler_destroy(context.scheduler);
+    free(context.scheduler);
+    context.scheduler = NULL;
+  }
+  context.num_image_threads = 0;
+
+  if (context.framebuffers != NULL)
+  {
+    framebuffer_ring_destroy(context.framebuffers);
+    free(context.framebuffers);
+    context.framebuffers = NULL;
+  }
+
+  if (context.backgrounds != NULL)
+  {
+    background_registry_destroy(context.backgrounds);
+    free(context.backgrounds);
+    context.backgrounds = NULL;
+  }
+
+  if (context.geometry != NULL)
+  {
+    geometry_ring_destroy(context.geometry);
+    free(context.geometry);
+    context.geometry = NULL;
+  }
+  context.geometry_callback = NULL;
+  free(context.entities);
+  context.entities = NULL;
+  context.num_entities = 0;
+  context.entities_capacity = 0;
+  context.entities_version = 0;
+  free(context.command_entities);
+  context.command_entities = NULL;
+  context.command_entities_capacity = 0;
+  set_frame_cache(&(struct frame_cache_settings){0, 0, 0});
+  context.warming_in_flight = false;
+  context.request.valid = false;
+  atomic_store(&context.last_frame_abandoned, false);
+  context.started_inputs_valid = false;
+  context.presented_valid = false;
+  // Workers started by the next initialize get the system's defaults
+  memset(&context.placement, 0, sizeof(context.placement));
+  memset(context.placement_status, 0, sizeof(context.placement_status));
+  unlock_context();
+}
+
+uint32_t detect_core_count(void)
+{
+#if _WIN32
+  SYSTEM_INFO system_info;
+  GetSystemInfo(&system_info);
+  long count = system_info.dwNumberOfProcessors;
+#else
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+  // Workers beyond what the process is allowed to run only wait for each other
+  uint32_t usable = cpu_placement_usable_cpus();
+  if (usable > 0 && (long)usable < count)
+  {
+    count = usable;
+  }
+  return count > 0 ? (uint32_t)count : 1;
+}
+
+uint32_t set_worker_placement(const struct worker_placement *placement)
+{
+  lock_context();
+  uint32_t applied = 0;
+  if (context.pool != NULL)
+  {
+    // A frame in flight is finished where it started
+    worker_pool_wait(context.pool);
+    context.placement = *placement;
+    context.placement_caller_cpu = cpu_placement_current_cpu();
+    worker_pool_run(context.pool, placement_job, NULL);
+    for (uint32_t i = 0; i < context.num_image_threads; i++)
+    {
+      applied += context.placement_status[i].applied;
+    }
+  }
+  unlock_context();
+  return applied;
+}
+
+uint32_t get_worker_placement(struct worker_placement_status *status, uint32_t capacity)
+{
+  lock_context();
+  // The workers write their status, waiting for them also makes their writes visible here
+  if (context.pool != NULL)
+  {
+    worker_pool_wait(context.pool);
+  }
+  uint32_t count = capacity < context.num_image_threads ? capacity : context.num_image_threads;
+  memcpy(status, context.placement_status, count * sizeof(struct worker_placement_status));
+  unlock_context();
+  return count;
+}
+
+void placement_job(void *data, uint32_t worker_index)
+{
+  (void)data;
+  // Every setting applies to the thread that makes the call, so each worker moves itself
+  cpu_placement_apply(&context.placement, worker_index, context.placement_caller_cpu, &context.placement_status[worker_index]);
+}
+
+void image_job(void *data, uint32_t worker_index)
+{
+  struct framebuffer *framebuffer = data;
+  struct worker_timing timing = {monotonic_nanoseconds(), 0, 0, 0, 0, {0}, cpu_placement_current_cpu(), -1};
+  trace_thread_name("worker", worker_index);
+
+  // Counters only count the thread that opened them, so every worker opens its own
+  struct perf_counters *counters = context.perf_counters != NULL ? &context.perf_counters[worker_index] : NULL;
+  if (counters != NULL && !counters->opened)
+  {
+    perf_counters_open(counters);
+  }
+  if (counters != NULL)
+  {
+    timing.counter_mask = counters->available;
+  }
+  uint64_t before[num_perf_counters], after[num_perf_counters];
+
+  uint64_t tile;
+  while (tile_scheduler_next(context.scheduler, worker_index, &tile))
+  {
+    // A newer request came in, the tiles still left are not worth rendering
+    if (framebuffer_superseded(context.framebuffers, framebuffer))
+    {
+      atomic_store(&framebuffer->abandoned, true);
+      break;
+    }
+    struct image_settings settings = context.frame_settings;
+    settings.start_row = context.frame_settings.start_row + tile * tile_rows;
+    settings.end_row = settings.start_row + tile_rows < context.frame_settings.end_row ? settings.start_row + tile_rows : context.frame_settings.end_row;
+    settings.bytes_written = 0;
+    // Pixels under the entities of the buffer's previous frame are written again even where the background did not change
+    if (compositor_covers_tile(framebuffer->previous_entities, framebuffer->num_previous_entities, &settings))
+    {
+      settings.expand = true;
+    }
+    uint64_t trace_started = trace_begin();
+    if (timing.counter_mask != 0)
+    {
+      perf_counters_read(counters, before);
+    }
+    image_thread_entry_point(&settings);
+    compositor_draw_tile(framebuffer, &settings);
+    if (timing.counter_mask != 0)
+    {
+      perf_counters_read(counters, after);
+      for (int i = 0; i < num_perf_counters; i++)
+      {
+        timing.counters[i] += after[i] - before[i];
+      }
+    }
+    trace_end("tile", trace_started, "tile", tile);
+    timing.tiles++;
+    timing.bytes_written += settings.bytes_written;
+  }
+
+  // Rows are written with streaming stores, make them visible before the frame is handed out
+  kernels.fence();
+
+  // Every worker owns its own entry, the frame is only read once they are all done
+  timing.end_nanoseconds = monotonic_nanoseconds();
+  timing.last_cpu = cpu_placement_current_cpu();
+  framebuffer->stats.workers[worker_index] = timing;
+}
+
+void image_thread_entry_point(struct image_settings *settings)
+{
+  background_render_tile(context.backgrounds, settings);
+}
+
+void emit_row(struct image_settings *settings, uint64_t y)
+{
+  if (settings->scale_shift > 0)
+  {
+    emit_scaled_row(settings, y, 0, settings->width);
+    return;
+  }
+  uint64_t first, end;
+  strip_columns(settings, y, &first, &end);
+  uint64_t offset = y * settings->stride + first;
+  kernels.expand_mask(&settings->pixels[offset], &settings->indices[offset], end - first, settings->colors.background_color, settings->colors.line_color, true);
+  settings->bytes_written += (end - first) * sizeof(struct rgba);
+}
+
+void emit_scaled_row(struct image_settings *settings, uint64_t y, uint64_t first_x, uint64_t end_x)
+{
+  uint64_t strip_first, strip_end;
+  strip_columns(settings, y, &strip_first, &strip_end);
+  first_x = first_x > strip_first ? first_x : strip_first;
+  end_x = end_x < strip_end ? end_x : strip_end;
+  uint64_t first_row = y << settings->scale_shift;
+  uint64_t end_row = (y + 1) << settings->scale_shift;
+  end_row = end_row < settings->output_height ? end_row : settings->output_height;
+  uint64_t output_end = end_x << settings->scale_shift;
+  output_end = output_end < settings->output_width ? output_end : settings->output_width;
+  const uint8_t *indices = &settings->indices[y * settings->stride];
+
+  // Nearest upscale, indices are widened a chunk at a time then expanded into every row they cover
+  uint8_t widened[1024];
+  for (uint64_t x = first_x << settings->scale_shift; x < output_end; x += sizeof(widened))
+  {
+    uint64_t count = output_end - x < sizeof(widened) ? output_end - x : sizeof(widened);
+    for (uint64_t i = 0; i < count; i++)
+    {
+      widened[i] = indices[(x + i) >> settings->scale_shift];
+    }
+    for (uint64_t row = first_row; row < end_row; row++)
+    {
+      kernels.expand_mask(&settings->pixels[row * settings->stride + x], widened, count, settings->colors.background_color, settings->colors.line_color, true);
+    }
+    settings->bytes_written += (end_row - first_row) * count * sizeof(struct rgba);
+  }
+}
+
+void strip_columns(const struct image_settings *settings, uint64_t y, uint64_t *start, uint64_t *end)
+{
+  bool whole_row = y >= settings->strip_rows_start && y < settings->strip_rows_end;
+  *start = whole_row ? 0 : settings->strip_columns_start;
+  *end = whole_row ? settings->width : settings->strip_columns_end;
+}
+
+void fill_row_spans(uint8_t *indices, uint64_t width, const struct span *spans, int num_spans)
+{
+  uint64_t x = 0;
+  for (int span_index = 0; span_index < num_spans; span_index++)
+  {
+    memset(&indices[x], palette_background, spans[span_index].start - x);
+    memset(&indices[spans[span_index].start], palette_line, spans[span_index].end - spans[span_index].start);
+    x = spans[span_index].end;
+  }
+  memset(&indices[x], palette_background, width - x);
+}
+
+uint32_t update_row_spans(uint8_t *indices, struct rgba *row, const struct row_state *previous, const struct span *spans, int num_spans, const struct colors *colors, struct span *extent)
+{
+  uint32_t num_pixels = 0;
+  struct span changed[4 * max_row_spans];
+  int num_changed = span_difference(previous->spans, previous->num_spans, spans, num_spans, changed);
+  for (int changed_index = 0; changed_index < num_changed; changed_index++)
+  {
+    uint32_t start = changed[changed_index].start, count = changed[changed_index].end - start;
+    bool line = spans_cover(spans, num_spans, start);
+    memset(&indices[start], line ? palette_line : palette_background, count);
+    num_pixels += count;
+    if (row != NULL)
+    {
+      kernels.fill_span(&row[start], count, line ? colors->line_color : colors->background_color, false);
+    }
+  }
+  if (num_changed > 0)
+  {
+    *extent = (struct span){changed[0].start, changed[num_changed - 1].end};
+  }
+  return num_pixels;
+}
+
+void store_row_spans(struct row_state *state, const struct span *spans, int num_spans)
+{
+  state->kind = row_kind_spans;
+  state->num_spans = num_spans;
+  state->template_index = 0;
+  memcpy(state->spans, spans, num_spans * sizeof(struct span));
+}
+
+int span_difference(const struct span *a, int num_a, const struct span *b, int num_b, struct span *difference)
+{
+  if (num_a == num_b && memcmp(a, b, num_a * sizeof(struct span)) == 0)
+  {
+    return 0;
+  }
+
+  // Spans of a row are sorted and never touch, so both lists are walked once boundary by boundary.
+  // An odd count of boundaries passed means the position is inside a span of that list.
+  int num_difference = 0;
+  int a_bound = 0, b_bound = 0;
+  uint32_t position = 0;
+  bool previous_in_b = false;
+  while (a_bound < 2 * num_a || b_bound < 2 * num_b)
+  {
+    uint32_t next_a = a_bound < 2 * num_a ? (a_bound & 1 ? a[a_bound >> 1].end : a[a_bound >> 1].start) : UINT32_MAX;
+    uint32_t next_b = b_bound < 2 * num_b ? (b_bound & 1 ? b[b_bound >> 1].end : b[b_bound >> 1].start) : UINT32_MAX;
+    uint32_t next = next_a < next_b ? next_a : next_b;
+    bool in_a = a_bound & 1, in_b = b_bound & 1;
+    if (in_a != in_b && next > position)
+    {
+      // Touching intervals are only merged when they end up the same color
+      if (num_difference > 0 && difference[num_difference - 1].end == position && previous_in_b == in_b)
+      {
+        difference[num_difference - 1].end = next;
+      }
+      else
+      {
+        difference[num_difference++] = (struct span){position, next};
+      }
+      previous_in_b = in_b;
+    }
+    position = next;
+    a_bound += next_a == next;
+    b_bound += next_b == next;
+  }
+  return num_difference;
+}
+
+bool spans_cover(const struct span *spans, int num_spans, uint32_t x)
+{
+  for (int span_index = 0; span_index < num_spans; span_index++)
+  {
+    if (x >= spans[span_index].start && x < spans[span_index].end)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool row_state_difference(const struct row_state *a, const struct row_state *b, uint64_t width, uint32_t *first, uint32_t *end)
+{
+  if (a->kind != b->kind || a->kind != row_kind_spans)
+  {
+    if (a->kind == b->kind && a->kind == row_kind_grid_template && a->template_index == b->template_index)
+    {
+      return false;
+    }
+    *first = 0;
+    *end = width;
+    return true;
+  }
+
+  struct span changed[4 * max_row_spans];
+  int num_changed = span_difference(a->spans, a->num_spans, b->spans, b->num_spans, changed);
+  if (num_changed == 0)
+  {
+    return false;
+  }
+  *first = changed[0].start;
+  *end = changed[num_changed - 1].end;
+  return true;
+}
+
+void compute_dirty_rects(struct framebuffer *framebuffer)
+{
+  struct framebuffer_ring *ring = context.framebuffers;
+  struct frame_key *key = &framebuffer->key;
+  framebuffer->num_dirty_rects = 0;
+
+  // Rows of a frame of strips do not describe what the consumer shows, the next frame is compared with nothing
+  if (framebuffer->shift.strips_only)
+  {
+    for (uint32_t i = 0; i < framebuffer->shift.num_strips; i++)
+    {
+      framebuffer->dirty_rects[framebuffer->num_dirty_rects++] = framebuffer->shift.strips[i];
+    }
+    ring->displayed_valid = false;
+    return;
+  }
+
+  if (!ring->displayed_valid || !frame_key_equal(ring->displayed_key, *key))
+  {
+    framebuffer->dirty_rects[framebuffer->num_dirty_rects++] = (struct rect){0, 0, framebuffer->width, framebuffer->height};
+  }
+  else
+  {
+    // One rectangle per band of rendered rows spanning every change within the band, scaled up to the output
+    uint32_t scale_shift = key->scale_shift;
+    for (uint64_t band_start = 0; band_start < key->render_height; band_start += tile_rows)
+    {
+      uint64_t band_end = band_start + tile_rows < key->render_height ? band_start + tile_rows : key->render_height;
+      uint32_t band_first = UINT32_MAX, band_last = 0, first_row = 0, last_row = 0;
+      for (uint64_t y = band_start; y < band_end; y++)
+      {
+        uint32_t first, end;
+        if (row_state_difference(&ring->displayed_rows[y], &framebuffer->rows[y], key->render_width, &first, &end))
+        {
+          if (band_first == UINT32_MAX)
+          {
+            first_row = y;
+          }
+          last_row = y;
+          band_first = first < band_first ? first : band_first;
+          band_last = end > band_last ? end : band_last;
+        }
+      }
+      struct rect rect = {0, 0, 0, 0};
+      if (band_first != UINT32_MAX)
+      {
+        rect = (struct rect){band_first << scale_shift, first_row << scale_shift, (band_last - band_first) << scale_shift, (last_row - first_row + 1) << scale_shift};
+        rect.width = rect.x + rect.width < framebuffer->width ? rect.width : framebuffer->width - rect.x;
+        rect.height = rect.y + rect.height < framebuffer->height ? rect.height : framebuffer->height - rect.y;
+      }
+      // Entities drawn now or in the displayed frame changed what is on screen, whether the background under them did or not
+      uint64_t output_start = band_start << scale_shift;
+      uint64_t output_end = band_end << scale_shift < framebuffer->height ? band_end << scale_shift : framebuffer->height;
+      compositor_extent(framebuffer->entities, framebuffer->num_entities, output_start, output_end, &rect);
+      compositor_extent(ring->displayed_entities, ring->num_displayed_entities, output_start, output_end, &rect);
+      if (rect.width > 0 && rect.height > 0)
+      {
+        framebuffer->dirty_rects[framebuffer->num_dirty_rects++] = rect;
+      }
+    }
+  }
+
+  memcpy(ring->displayed_rows, framebuffer->rows, key->render_height * sizeof(struct row_state));
+  ring->displayed_key = *key;
+  ring->displayed_valid = true;
+  if (framebuffer->num_entities > ring->displayed_entities_capacity)
+  {
+    struct placed_entity *entities = realloc(ring->displayed_entities, framebuffer->num_entities * sizeof(struct placed_entity));
+    if (entities == NULL)
+    {
+      // The next frame is then compared with nothing, which only makes it dirty everywhere
+      ring->displayed_valid = false;
+      return;
+    }
+    ring->displayed_entities = entities;
+    ring->displayed_entities_capacity = framebuffer->num_entities;
+  }
+  if (framebuffer->num_entities > 0)
+  {
+    memcpy(ring->displayed_entities, framebuffer->entities, framebuffer->num_entities * sizeof(struct placed_entity));
+  }
+  ring->num_displayed_entities = framebuffer->num_entities;
+}
+
+bool frame_key_equal(struct frame_key a, struct frame_key b)
+{
+  return frame_key_same_indices(a, b) && rgba_equal(a.background_color, b.background_color) && rgba_equal(a.line_color, b.line_color);
+}
+
+bool frame_key_same_indices(struct frame_key a, struct frame_key b)
+{
+  return a.config == b.config && a.width == b.width && a.height == b.height && a.render_width == b.render_width && a.render_height == b.render_height &&
+         a.sample_scale == b.sample_scale && a.x_offset == b.x_offset;
+}
+
+bool frame_inputs_equal(struct frame_inputs a, struct frame_inputs b)
+{
+  return a.config == b.config && a.width == b.width && a.height == b.height && a.device_pixel_ratio == b.device_pixel_ratio && a.scale_shift == b.scale_shift &&
+         rgba_equal(a.background_color, b.background_color) && rgba_equal(a.line_color, b.line_color) && a.cycle_time == b.cycle_time &&
+         a.x_offset == b.x_offset && a.y_offset == b.y_offset && a.entities_version == b.entities_version;
 }
 
-bool is_index_in_range(int index, double base, struct range range)
+bool rgba_equal(struct rgba a, struct rgba b)
 {
-  return (index >= base + range.offset - range.tolerance && index <= base + range.offset + range.tolerance);
+  return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
 }
 
 int round_double_to_int(double x)
@@ -3,7 +3,9 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 #include <threads.h>
 #include <math.h>
 
@@ -24,25 +26,228 @@
 #define square_stroke_thickness 2
 #define square_stroke_spacing 50
 
-typedef void(*frame_callback)(uint64_t width, uint64_t height, uint64_t data_size, void *data);
+#define num_grid_row_kinds 4
 
+#define max_row_spans 16
+
+#define num_palette_colors 2
+
+#define tile_rows 16
+#define max_image_threads 64
+
+// Presented frames whose stats are kept for get_frame_stats
+#define frame_stats_history 64
+
+// First byte of every submit_commands stream, streams of any other version are rejected whole
+#define command_stream_version 1
+
+// Widest and tallest background accepted in logical pixels, so the planes of a frame stay far from overflowing their byte counts
+#define max_background_size 16384
+#define max_device_pixel_ratio 8
+
+#define max_render_scale_shift 2
+// Frames rendered at one scale before the controller may pick another
+#define render_scale_settle_frames 8
+
+struct framebuffer;
+struct background_registry;
+struct frame_stats_ring;
+struct perf_counters;
+struct frame_cache;
+struct geometry_ring;
+struct geometry_frame;
+struct placed_entity;
+
+// The frame's pixels stay untouched until the consumer calls release_frame with its id.
+// Rows are row_bytes apart, which can be more than width pixels.
+typedef void(*frame_callback)(uint64_t frame_id, uint64_t width, uint64_t height, uint64_t row_bytes, uint64_t data_size, void *data);
+
+// Receives frames as geometry once set_geometry_output chose it, the frame stays untouched until release_frame is called with its id.
+typedef void(*geometry_callback)(uint64_t frame_id, const struct geometry_frame *frame);
+
+// Ids of the registered backgrounds
 typedef enum
 {
     grid,
-    wave
+    wave,
+    num_configurations
 } configuration;
 
+typedef enum
+{
+    render_sync,
+    render_async
+} render_mode;
+
+// What draw_background did with a request
+typedef enum
+{
+    // A frame was started, it reaches frame_callback once rendered
+    draw_started,
+    // The background would come out the same as the last frame, nothing is rendered and no frame follows
+    draw_unchanged,
+    // No frame could start now, a later call renders from the newest request
+    draw_deferred,
+    // submit_commands was given a stream it could not read or find the memory for, none of it was applied
+    draw_rejected
+} draw_status;
+
+// Commands of a submit_commands stream, each an opcode byte followed by its operands, little-endian
+typedef enum
+{
+    // uint8_t config, as update_background_config
+    command_config,
+    // int32_t increment, as update_background_color
+    command_color,
+    // uint64_t width, height
+    command_size,
+    // uint32_t count, then count entities as uint8_t kind, r, g, b, a and float x0, y0, x1, y1, x2, y2, width
+    command_entities,
+    // uint64_t cycle_time, int64_t x_offset, y_offset, as draw_background
+    command_draw
+} command_opcode;
+
+// Fraction of the output resolution that is actually rendered, the rest is filled by upscaling
+typedef enum
+{
+    render_scale_full,
+    render_scale_half,
+    render_scale_quarter
+} render_scale;
+
+// Hardware counters sampled around every tile once set_perf_counters turned them on
+typedef enum
+{
+    perf_cycles,
+    perf_instructions,
+    // Misses of the last level cache, which have to go to memory
+    perf_llc_misses,
+    // Cycles the back end of the core could not make progress, mostly waiting on memory
+    perf_stalled_cycles,
+    num_perf_counters
+} perf_counter;
+
+// How the system schedules render workers, see set_worker_placement
+typedef enum
+{
+    worker_policy_default,
+    // Longer time slices and no preemption boosts, for throughput over latency
+    worker_policy_batch,
+    // Only runs when nothing else wants the CPU
+    worker_policy_idle,
+    // Real time policies, usually only granted to privileged processes
+    worker_policy_fifo,
+    worker_policy_round_robin
+} worker_policy;
+
+// Shapes set_entities draws over the background, coordinates are logical pixels
+typedef enum
+{
+    // Filled circle around x0, y0, width is its radius
+    entity_circle,
+    // Rectangle from x0, y0 to x1, y1, filled when width is zero and otherwise only a border width thick inside it
+    entity_rect,
+    // Segment from x0, y0 to x1, y1 width thick with square ends, drawn along the axis it is longer on
+    entity_line,
+    // Filled triangle x0, y0, x1, y1, x2, y2
+    entity_triangle
+} entity_kind;
+
+typedef enum
+{
+    kernel_isa_auto,
+    kernel_isa_scalar,
+    kernel_isa_sse2,
+    kernel_isa_avx2,
+    kernel_isa_neon
+} kernel_isa;
+
 struct range
 {
     double offset;
     double tolerance;
 };
 
+// Half-open run of pixels [start, end) within a row
+struct span
+{
+    uint32_t start;
+    uint32_t end;
+};
+
+// Area of a frame in pixels, from its top left corner
+struct rect
+{
+    uint32_t x, y, width, height;
+};
+
+// How a frame relates to the one presented before it, base_frame_id, when the background only moved
+struct frame_shift
+{
+    // Set when both frames have the same background, size, scale and colors, the rest is meaningless otherwise
+    bool valid;
+    // Set when every pixel outside the strips is the pixel of the base frame dx, dy away.
+    // Otherwise dx, dy is only how far the background moved overall.
+    bool exact;
+    // Only the strips were rendered, the rest of the frame is the base frame shifted by dx, dy
+    bool strips_only;
+    uint64_t base_frame_id;
+    // Whole output pixels, positive to the right and down
+    int64_t dx, dy;
+    // Areas the shifted base frame leaves uncovered, the whole frame when it moved out of view
+    uint32_t num_strips;
+    struct rect strips[2];
+};
+
 struct rgba
 {
     uint8_t r, g, b, a;
 };
 
+// One shape drawn over the background, blended by the alpha of its color
+struct entity
+{
+    uint8_t kind;
+    struct rgba color;
+    float x0, y0, x1, y1, x2, y2;
+    float width;
+};
+
+// A frame filled with the background color, with the line colored areas drawn over it as triangles
+struct geometry_frame
+{
+    uint64_t width, height;
+    struct rgba background_color;
+    struct rgba line_color;
+    // Output pixel x, y pairs, every three vertices make a triangle
+    uint32_t num_vertices;
+    float *vertices;
+};
+
+// Renderers write one of these per pixel, expanded to the frame's colors afterwards
+typedef enum
+{
+    palette_background,
+    palette_line
+} palette_index;
+
+typedef enum
+{
+    row_kind_unknown,
+    row_kind_spans,
+    row_kind_grid_template
+} row_kind;
+
+// What a framebuffer row currently holds, used to only rewrite what changed in the next frame
+struct row_state
+{
+    uint16_t kind;
+    uint16_t num_spans;
+    // Grid rows record which template they were copied from
+    uint32_t template_index;
+    struct span spans[max_row_spans];
+};
+
 struct colors
 {
     struct rgba background_color;
@@ -50,6 +255,36 @@ struct colors
     struct rgba widget_color;
 };
 
+// The inputs that decide whether a framebuffer's content can be updated in place
+struct frame_key
+{
+    configuration config;
+    uint64_t width, height;
+    uint64_t render_width, render_height;
+    uint32_t scale_shift;
+    double sample_scale;
+    struct rgba background_color;
+    struct rgba line_color;
+    int64_t x_offset;
+};
+
+// Everything the pixels of a frame come from, frames with equal inputs are identical
+struct frame_inputs
+{
+    configuration config;
+    uint64_t width, height;
+    double device_pixel_ratio;
+    uint32_t scale_shift;
+    struct rgba background_color;
+    struct rgba line_color;
+    // Zero for the ones the background does not depend on
+    uint64_t cycle_time;
+    int64_t x_offset, y_offset;
+    // Zero while no entity is drawn over the background, changed by every set_entities that changes them
+    uint64_t entities_version;
+};
+
+// Everything a worker needs to render its rows, captured once per frame
 struct image_settings
 {
     configuration config;
@@ -58,19 +293,169 @@ struct image_settings
     uint64_t y_offset;
     uint64_t start_row;
     uint64_t end_row;
+    // Rows and widths renderers work with, before upscaling
+    uint64_t width, height;
+    uint64_t output_width, output_height;
+    uint64_t stride;
+    uint32_t scale_shift;
+    // Logical pixels covered by one rendered pixel
+    double sample_scale;
+    uint64_t logical_width;
+    struct colors colors;
+    struct rgba *pixels;
+    struct row_state *rows;
+    uint8_t *indices;
+    bool incremental;
+    // The rows are expanded from their palette indices rather than written in place
+    bool expand;
+    // RGBA bytes written to the frame by the rows rendered with these settings
+    uint64_t bytes_written;
+    // Rows outside strip_rows_start to strip_rows_end only have their pixels from strip_columns_start to strip_columns_end written.
+    // The whole frame unless only the strips of a shifted frame are rendered.
+    uint64_t strip_rows_start, strip_rows_end;
+    uint64_t strip_columns_start, strip_columns_end;
 };
 
-struct image_thread
+struct image
 {
-    struct image_settings settings;
-    thrd_t thread;
+    uint64_t width, height;
+    configuration config;
 };
 
-struct image
+// Palette indices of a held frame at its render resolution, rows are stride bytes apart
+struct index_plane
 {
+    const uint8_t *indices;
     uint64_t width, height;
+    uint64_t stride;
+    struct rgba palette[num_palette_colors];
+};
+
+// Moves the render scale to keep the time spent rendering each frame within budget
+struct render_scale_controller
+{
+    uint32_t scale_shift;
+    double device_pixel_ratio;
+    // Zero keeps the scale fixed
+    double budget_milliseconds;
+    double average_milliseconds;
+    uint32_t frames_at_scale;
+};
+
+// Parameters of the latest draw_background, every frame is prepared from the newest ones
+struct render_request
+{
+    uint64_t cycle_time;
+    int64_t x_offset;
+    int64_t y_offset;
+    uint64_t requested_nanoseconds;
+    // Cleared by shutdown, nothing is rendered from the request until draw_background made one
+    bool valid;
+};
+
+// What a command stream leaves the background as, read in full before any of it reaches the context
+struct command_batch
+{
+    uint8_t config;
+    struct rgba background_color;
+    uint64_t width, height;
+    // Set when the stream replaced the entities, they are decoded into the context's command_entities
+    bool entities;
+    uint32_t num_entities;
+    // Valid when the stream asked for a draw, the newest one
+    struct render_request request;
+};
+
+// One worker's share of a frame, times are monotonic_nanoseconds
+struct worker_timing
+{
+    uint64_t start_nanoseconds;
+    uint64_t end_nanoseconds;
+    uint32_t tiles;
+    uint64_t bytes_written;
+    // Bit i set when counters[i] was measured, zero when the counters are off or were refused
+    uint32_t counter_mask;
+    uint64_t counters[num_perf_counters];
+    // CPUs the worker started and finished its share on, -1 where the system does not tell
+    int32_t first_cpu;
+    int32_t last_cpu;
+};
+
+// Where the time of a presented frame went, times are monotonic_nanoseconds
+struct frame_stats
+{
+    uint64_t frame_id;
     configuration config;
-    struct rgba *pixels;
+    // The draw_background call that started the frame
+    uint64_t requested_nanoseconds;
+    uint64_t render_started_nanoseconds;
+    // Time the caller spent blocked until every worker was done, zero when rendering asynchronously
+    uint64_t wait_nanoseconds;
+    uint64_t presented_nanoseconds;
+    uint64_t callback_nanoseconds;
+    uint64_t bytes_written;
+    // Frames lost since the previous frame was presented, for want of a free buffer or because a newer one replaced them
+    uint64_t dropped_frames;
+    // Copied out of the frame cache rather than rendered, no worker took part
+    bool cached;
+    uint32_t num_workers;
+    struct worker_timing workers[max_image_threads];
+};
+
+// Where render workers may run and how they are scheduled
+struct worker_placement
+{
+    // Bit i for CPU i, zero for every CPU the process may use
+    uint64_t cpu_mask;
+    // CPUs left to other threads, such as Flutter's raster thread
+    uint64_t reserved_cpu_mask;
+    // Also leaves the CPU the caller of set_worker_placement runs on, which is Flutter's UI thread in the app
+    bool reserve_caller_cpu;
+    // One CPU per worker, in turn, rather than the whole set for all of them
+    bool pin;
+    worker_policy policy;
+    // Used with the default, batch and idle policies
+    int32_t nice;
+    // Used with the real time policies
+    int32_t priority;
+};
+
+// What a worker ended up with, read back from the system after set_worker_placement
+struct worker_placement_status
+{
+    // Zero when the affinity could not be read
+    uint64_t cpu_mask;
+    worker_policy policy;
+    int32_t nice;
+    int32_t priority;
+    // False when any part of the placement was refused, the rest is still applied
+    bool applied;
+};
+
+struct framebuffer_memory
+{
+    uint64_t current_bytes;
+    uint64_t peak_bytes;
+};
+
+struct frame_cache_settings
+{
+    // Memory the cached frames may take, zero turns the cache off and frees every frame in it
+    uint64_t budget_bytes;
+    // Cycle times are rounded down to a multiple of it, one step of the animation is then a single frame
+    uint64_t time_quantum;
+    // Cycle times are taken modulo it when it is not zero, the animation loops through a fixed set of frames
+    uint64_t cycle_period;
+};
+
+struct frame_cache_stats
+{
+    uint64_t budget_bytes;
+    uint64_t used_bytes;
+    uint32_t num_frames;
+    // Frames warm_frame_cache still has to render
+    uint32_t warm_frames_left;
+    uint64_t hits, misses, evictions;
 };
 
 struct context
@@ -78,27 +463,239 @@ struct context
     frame_callback frame_callback;
     struct colors colors;
     struct image background;
-    uint8_t num_image_threads;
-    struct image_thread *image_threads;
+    struct background_registry *backgrounds;
+    uint32_t num_image_threads;
+    struct image_settings frame_settings;
+    struct tile_scheduler *scheduler;
+    struct worker_pool *pool;
+    struct framebuffer_ring *framebuffers;
+    struct frame_stats_ring *frame_stats;
+    // Set from C_LAYER_TRACE, the trace recorded since initialize is written there on shutdown
+    const char *trace_path;
+    // One set per worker while set_perf_counters has them on, each opened by its worker on its next frame
+    struct perf_counters *perf_counters;
+    struct worker_placement placement;
+    int32_t placement_caller_cpu;
+    struct worker_placement_status placement_status[max_image_threads];
+    render_mode render_mode;
+    struct render_request request;
+    // Set when the last frame the workers finished was given up for a newer request, written by the worker that finished it
+    atomic_bool last_frame_abandoned;
+    // Inputs of the last frame started, a request with the same ones is answered with draw_unchanged
+    struct frame_inputs started_inputs;
+    bool started_inputs_valid;
+    // Only allocated while set_frame_cache has given it a budget
+    struct frame_cache *frame_cache;
+    struct frame_cache_settings frame_cache_settings;
+    // Next frame warm_frame_cache asked for, rendered whenever a request leaves the workers with nothing to do
+    struct render_request warm_request;
+    uint32_t warm_frames_left;
+    // Tells what the busy workers are rendering, a warming frame gives way to any request
+    bool warming_in_flight;
+    // Inputs of the last frame handed to the consumer, the base of the next frame's shift
+    struct frame_inputs presented_inputs;
+    uint64_t presented_frame_id;
+    bool presented_valid;
+    bool strip_rendering;
+    // Frames go to geometry_callback as geometry instead of being rasterized while it is set
+    geometry_callback geometry_callback;
+    struct geometry_ring *geometry;
+    // Drawn over every pixel frame prepared after set_entities, in order
+    struct entity *entities;
+    uint32_t num_entities;
+    uint32_t entities_capacity;
+    uint64_t entities_version;
+    uint64_t entities_generation;
+    bool incremental;
+    struct render_scale_controller render_scale;
+    // Entities of the command stream being applied, decoded before set_entities copies them
+    struct entity *command_entities;
+    uint32_t command_entities_capacity;
+    // Serializes every call into the library but get_frame_stats, recursive since a frame callback may call back in.
+    // Created once by whichever call comes first and kept for the life of the process.
     mtx_t mutex;
+    bool mutex_ready;
 };
 
-FLOW_API void initialize(frame_callback frame_callback, uint64_t width, uint64_t height);
+FLOW_API void initialize(frame_callback frame_callback, uint64_t width, uint64_t height, uint32_t num_threads);
 
 FLOW_API void update_background_color(int increment);
 
+// Sizes above max_background_size are ignored, the background keeps the size it had.
 FLOW_API void update_background_size(uint64_t width, uint64_t height, uint64_t cycle_time, int64_t x_offset, int64_t y_offset);
 
 FLOW_API void update_background_config(uint8_t config_byte);
 
-FLOW_API void draw_background(uint64_t cycle_time, int64_t x_offset, int64_t y_offset);
+// Returns a draw_status, only draw_started is followed by a frame.
+FLOW_API uint8_t draw_background(uint64_t cycle_time, int64_t x_offset, int64_t y_offset);
+
+// Applies every command of a command_stream_version stream in order, then renders once from the newest request.
+// Nothing is rendered without a command_draw unless the size or background changed and a request was made before.
+// Returns a draw_status, draw_rejected when any of the stream is malformed, out of memory or sized above max_background_size,
+// none of it is applied then.
+FLOW_API uint8_t submit_commands(const uint8_t *buffer, size_t length);
+
+FLOW_API void shutdown(void);
+
+// Switches the pixel kernels once the frame in flight is done, returns the kernel_isa actually in use.
+FLOW_API uint8_t select_kernels(uint8_t isa_byte);
+
+FLOW_API void set_render_mode(uint8_t mode_byte);
+
+FLOW_API void release_frame(uint64_t frame_id);
+
+FLOW_API void set_incremental_rendering(uint8_t enabled);
+
+FLOW_API uint32_t get_dirty_rects(uint64_t frame_id, struct rect *rects, uint32_t capacity);
+
+// Renders only the strips of frames that are exactly the previous one shifted, the consumer draws its previous frame shifted under them.
+FLOW_API void set_strip_rendering(uint8_t enabled);
+
+// Copies the shift of a held frame relative to the frame presented before it, false when the frame is not held.
+FLOW_API bool get_frame_shift(uint64_t frame_id, struct frame_shift *shift);
+
+// Hands frames to callback as geometry built on the caller's thread rather than as pixels, NULL goes back to pixels.
+// Backgrounds that cannot be described as geometry are not drawn while it is set.
+FLOW_API void set_geometry_output(geometry_callback callback);
+
+// Draws num_entities entities over every following pixel frame, clipped to every tile by the worker rendering it, until the next call.
+// Frames with entities are never cached and geometry frames never have them. Returns false when memory ran out, the previous entities are then kept.
+FLOW_API bool set_entities(const struct entity *entities, uint32_t num_entities);
+
+FLOW_API bool get_frame_indices(uint64_t frame_id, struct index_plane *plane);
+
+FLOW_API struct framebuffer_memory get_framebuffer_memory(void);
+
+// Copies the stats of up to capacity of the most recently presented frames, oldest first, and returns how many were copied.
+FLOW_API uint32_t get_frame_stats(struct frame_stats *stats, uint32_t capacity);
+
+FLOW_API void set_render_scale(uint8_t scale_byte);
+
+FLOW_API uint8_t get_render_scale(void);
+
+// Renders up to ratio output pixels per logical pixel, 1 keeps frames at the logical size, ratios above max_device_pixel_ratio are capped.
+FLOW_API void set_device_pixel_ratio(double ratio);
+
+// Lets the render scale follow the time frames take to render, 0 keeps it where set_render_scale put it.
+FLOW_API void set_frame_budget(double milliseconds);
+
+// CPUs the process can actually use, bounded by its affinity and its cgroup CPU quota where there is one.
+FLOW_API uint32_t detect_core_count(void);
+
+// Moves every render worker to placement and returns how many took all of it, workers started by initialize begin with the defaults.
+FLOW_API uint32_t set_worker_placement(const struct worker_placement *placement);
+
+// Copies what up to capacity workers ended up with after set_worker_placement, and returns how many were copied.
+FLOW_API uint32_t get_worker_placement(struct worker_placement_status *status, uint32_t capacity);
+
+// Samples hardware counters around every tile into the worker timings of get_frame_stats, 0 turns them off.
+// Returns the mask of perf_counter bits this system permits, zero where there are none, as off Linux.
+FLOW_API uint32_t set_perf_counters(uint8_t enabled);
+
+// Frames are kept by everything they were rendered from, and shown again by copying them rather than rendering them.
+FLOW_API void set_frame_cache(const struct frame_cache_settings *settings);
+
+// Renders num_frames frames into the cache, from cycle_time one time_quantum apart, with the current background, size and colors.
+// Frames are rendered one at a time when a draw_background call has nothing else for the workers, a new call replaces what is left.
+// Returns how many of the frames were not cached yet.
+FLOW_API uint32_t warm_frame_cache(uint64_t cycle_time, uint32_t num_frames, int64_t x_offset, int64_t y_offset);
+
+FLOW_API struct frame_cache_stats get_frame_cache_stats(void);
+
+// Starts recording a fresh trace of every thread that renders or hands out frames, 0 stops recording.
+FLOW_API void set_tracing(uint8_t enabled);
+
+// Writes what has been recorded as Chrome trace JSON, which chrome://tracing and Perfetto open.
+FLOW_API bool write_trace(const char *path);
+
+// The clock trace events are timed with, so events recorded outside of the library line up with it.
+FLOW_API uint64_t trace_clock(void);
+
+// Records an event timed with trace_clock on a track of its own, name has to stay valid until the trace is written.
+FLOW_API void trace_dart_event(const char *name, uint64_t start_nanoseconds, uint64_t end_nanoseconds);
+
+draw_status render_background(uint64_t cycle_time, int64_t x_offset, int64_t y_offset);
+
+// False when the stream is malformed or its entities do not fit in memory, the context is left as it was.
+bool stage_commands(const uint8_t *buffer, size_t length, struct command_batch *batch);
+
+draw_status apply_commands(const struct command_batch *batch);
+
+struct rgba step_background_color(struct rgba color, int increment);
+
+bool reserve_entities(uint32_t num_entities);
+
+void create_context_mutex(void);
+
+void lock_context(void);
+
+void unlock_context(void);
+
+draw_status render_latest_request(void);
+
+draw_status render_geometry(const struct render_request *request, struct frame_inputs inputs);
+
+struct frame_inputs request_inputs(const struct render_request *request);
+
+uint64_t cycle_phase(uint64_t cycle_time);
+
+void take_finished_frame(void);
+
+bool show_cached_frame(struct framebuffer *framebuffer, const struct render_request *request, struct frame_inputs inputs);
+
+void warm_next_frame(void);
+
+void compute_frame_shift(struct framebuffer *framebuffer);
+
+void strip_columns(const struct image_settings *settings, uint64_t y, uint64_t *start, uint64_t *end);
+
+struct frame_inputs warm_request_inputs(void);
+
+uint64_t warm_step(void);
+
+bool prepare_frame(struct framebuffer *framebuffer, uint64_t requested, uint64_t cycle_time, int64_t x_offset, int64_t y_offset);
+
+void present_frame(struct framebuffer *framebuffer);
+
+void render_frame_done(void *data);
+
+void record_render_time(struct framebuffer *framebuffer);
+
+void adapt_render_scale(double milliseconds);
+
+uint64_t monotonic_nanoseconds(void);
+
+void image_job(void *data, uint32_t worker_index);
+
+void placement_job(void *data, uint32_t worker_index);
 
 void image_thread_entry_point(struct image_settings *settings);
 
-void grid_configuration(struct image_settings *settings);
+void emit_row(struct image_settings *settings, uint64_t y);
+
+void emit_scaled_row(struct image_settings *settings, uint64_t y, uint64_t first_x, uint64_t end_x);
+
+void fill_row_spans(uint8_t *indices, uint64_t width, const struct span *spans, int num_spans);
+
+// Rewrites the pixels whose coverage changed since previous and returns how many, extent receives the range they span.
+uint32_t update_row_spans(uint8_t *indices, struct rgba *row, const struct row_state *previous, const struct span *spans, int num_spans, const struct colors *colors, struct span *extent);
+
+void store_row_spans(struct row_state *state, const struct span *spans, int num_spans);
+
+int span_difference(const struct span *a, int num_a, const struct span *b, int num_b, struct span *difference);
+
+bool spans_cover(const struct span *spans, int num_spans, uint32_t x);
+
+bool row_state_difference(const struct row_state *a, const struct row_state *b, uint64_t width, uint32_t *first, uint32_t *end);
+
+void compute_dirty_rects(struct framebuffer *framebuffer);
+
+bool frame_key_equal(struct frame_key a, struct frame_key b);
+
+bool frame_key_same_indices(struct frame_key a, struct frame_key b);
 
-void wave_configuration(struct image_settings *settings);
+bool frame_inputs_equal(struct frame_inputs a, struct frame_inputs b);
 
-bool is_index_in_range(int index, double base, struct range range);
+bool rgba_equal(struct rgba a, struct rgba b);
 
 int round_double_to_int(double x);
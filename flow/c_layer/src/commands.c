@@ -0,0 +1,119 @@
+#include "commands.h"
+
+// Operands are little-endian whatever the host is
+static uint32_t read_u32(const uint8_t *bytes)
+{
+  return (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+static uint64_t read_u64(const uint8_t *bytes)
+{
+  return (uint64_t)read_u32(bytes) | (uint64_t)read_u32(bytes + 4) << 32;
+}
+
+static float read_f32(const uint8_t *bytes)
+{
+  uint32_t bits = read_u32(bytes);
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+bool command_reader_start(struct command_reader *reader, const uint8_t *buffer, size_t length)
+{
+  if (buffer == NULL || length == 0 || buffer[0] != command_stream_version)
+  {
+    reader->next = reader->end = NULL;
+    return false;
+  }
+  reader->next = buffer + 1;
+  reader->end = buffer + length;
+  return true;
+}
+
+bool command_next(struct command_reader *reader, struct command *command)
+{
+  if (reader->next == reader->end)
+  {
+    return false;
+  }
+  size_t left = (size_t)(reader->end - reader->next) - 1;
+  const uint8_t *operands = reader->next + 1;
+  size_t size;
+  command->opcode = reader->next[0];
+  switch (command->opcode)
+  {
+    case command_config:
+      size = 1;
+      if (left >= size)
+      {
+        command->config = operands[0];
+      }
+      break;
+    case command_color:
+      size = 4;
+      if (left >= size)
+      {
+        command->increment = (int32_t)read_u32(operands);
+      }
+      break;
+    case command_size:
+      size = 16;
+      if (left >= size)
+      {
+        command->width = read_u64(operands);
+        command->height = read_u64(operands + 8);
+      }
+      break;
+    case command_entities:
+      // The count is read first, the entities then have to fit in what is left
+      if (left < 4)
+      {
+        return false;
+      }
+      command->num_entities = read_u32(operands);
+      command->entities = operands + 4;
+      if (command->num_entities > (left - 4) / command_entity_size)
+      {
+        return false;
+      }
+      size = 4 + (size_t)command->num_entities * command_entity_size;
+      break;
+    case command_draw:
+      size = 24;
+      if (left >= size)
+      {
+        command->cycle_time = read_u64(operands);
+        command->x_offset = (int64_t)read_u64(operands + 8);
+        command->y_offset = (int64_t)read_u64(operands + 16);
+      }
+      break;
+    default:
+      return false;
+  }
+  if (left < size)
+  {
+    return false;
+  }
+  reader->next = operands + size;
+  return true;
+}
+
+bool command_reader_done(const struct command_reader *reader)
+{
+  return reader->next != NULL && reader->next == reader->end;
+}
+
+void command_entity(const uint8_t *entities, uint32_t index, struct entity *entity)
+{
+  const uint8_t *bytes = entities + (size_t)index * command_entity_size;
+  entity->kind = bytes[0];
+  entity->color = (struct rgba){bytes[1], bytes[2], bytes[3], bytes[4]};
+  entity->x0 = read_f32(bytes + 5);
+  entity->y0 = read_f32(bytes + 9);
+  entity->x1 = read_f32(bytes + 13);
+  entity->y1 = read_f32(bytes + 17);
+  entity->x2 = read_f32(bytes + 21);
+  entity->y2 = read_f32(bytes + 25);
+  entity->width = read_f32(bytes + 29);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "c_layer.h"
+
+// Bytes an entity takes in a command_entities operand
+#define command_entity_size 33
+
+// One decoded command, operands point into the stream for entities
+struct command
+{
+    command_opcode opcode;
+    uint8_t config;
+    int32_t increment;
+    uint64_t width, height;
+    uint32_t num_entities;
+    const uint8_t *entities;
+    uint64_t cycle_time;
+    int64_t x_offset, y_offset;
+};
+
+struct command_reader
+{
+    const uint8_t *next;
+    const uint8_t *end;
+};
+
+// False when the stream is not of command_stream_version, the reader then yields nothing.
+bool command_reader_start(struct command_reader *reader, const uint8_t *buffer, size_t length);
+
+// Decodes the next command, false at the end of the stream and on a command that is unknown or cut short.
+bool command_next(struct command_reader *reader, struct command *command);
+
+// Whether the reader stopped at the end of the stream rather than on a malformed command.
+bool command_reader_done(const struct command_reader *reader);
+
+void command_entity(const uint8_t *entities, uint32_t index, struct entity *entity);
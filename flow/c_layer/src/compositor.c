@@ -0,0 +1,264 @@
+#include "compositor.h"
+
+// First pixel whose centre is at or past position
+static int64_t first_pixel(float position)
+{
+  return (int64_t)ceilf(position - 0.5f);
+}
+
+static float min_float(float a, float b)
+{
+  return a < b ? a : b;
+}
+
+static float max_float(float a, float b)
+{
+  return a > b ? a : b;
+}
+
+static int64_t clamp_pixel(int64_t x, uint64_t end)
+{
+  return x < 0 ? 0 : x > (int64_t)end ? (int64_t)end : x;
+}
+
+// Blends color over the pixels of a row from first to end, the frame's alpha stays what the background wrote
+static uint64_t fill_span(struct rgba *row, int64_t first, int64_t end, uint64_t width, struct rgba color)
+{
+  first = clamp_pixel(first, width);
+  end = clamp_pixel(end, width);
+  if (color.a == 255)
+  {
+    for (int64_t x = first; x < end; x++)
+    {
+      row[x].r = color.r;
+      row[x].g = color.g;
+      row[x].b = color.b;
+    }
+  }
+  else
+  {
+    uint32_t alpha = color.a, rest = 255 - color.a;
+    for (int64_t x = first; x < end; x++)
+    {
+      row[x].r = (uint8_t)((color.r * alpha + row[x].r * rest + 127) / 255);
+      row[x].g = (uint8_t)((color.g * alpha + row[x].g * rest + 127) / 255);
+      row[x].b = (uint8_t)((color.b * alpha + row[x].b * rest + 127) / 255);
+    }
+  }
+  return end > first ? (uint64_t)(end - first) : 0;
+}
+
+// Where the row's centre line enters and leaves the triangle, false when it misses it
+static bool triangle_span(const struct placed_entity *entity, float center, float *left, float *right)
+{
+  const float xs[3] = {entity->x0, entity->x1, entity->x2};
+  const float ys[3] = {entity->y0, entity->y1, entity->y2};
+  int crossings = 0;
+  for (int i = 0; i < 3; i++)
+  {
+    float ax = xs[i], ay = ys[i], bx = xs[(i + 1) % 3], by = ys[(i + 1) % 3];
+    // Edges are half open in y so a row through a vertex counts it once
+    if ((ay <= center && center < by) || (by <= center && center < ay))
+    {
+      float x = ax + (center - ay) * (bx - ax) / (by - ay);
+      *left = crossings == 0 ? x : min_float(*left, x);
+      *right = crossings == 0 ? x : max_float(*right, x);
+      crossings++;
+    }
+  }
+  return crossings >= 2;
+}
+
+static uint64_t draw_row(const struct placed_entity *entity, struct rgba *row, uint64_t y, uint64_t width)
+{
+  float center = y + 0.5f;
+  switch (entity->kind)
+  {
+    case entity_circle:
+    {
+      float dy = center - entity->y0;
+      float squared = entity->width * entity->width - dy * dy;
+      if (squared <= 0)
+      {
+        return 0;
+      }
+      float half = sqrtf(squared);
+      return fill_span(row, first_pixel(entity->x0 - half), first_pixel(entity->x0 + half), width, entity->color);
+    }
+    case entity_rect:
+    case entity_line:
+    {
+      // Lines are placed as the rectangle they cover, only rectangles with a border have a hole
+      int64_t first = first_pixel(entity->x0), end = first_pixel(entity->x1);
+      bool inside = entity->width > 0 && center >= entity->y0 + entity->width && center < entity->y1 - entity->width;
+      if (!inside)
+      {
+        return fill_span(row, first, end, width, entity->color);
+      }
+      int64_t hole_first = first_pixel(entity->x0 + entity->width), hole_end = first_pixel(entity->x1 - entity->width);
+      if (hole_first >= hole_end)
+      {
+        return fill_span(row, first, end, width, entity->color);
+      }
+      return fill_span(row, first, hole_first, width, entity->color) + fill_span(row, hole_end, end, width, entity->color);
+    }
+    case entity_triangle:
+    {
+      float left, right;
+      if (!triangle_span(entity, center, &left, &right))
+      {
+        return 0;
+      }
+      return fill_span(row, first_pixel(left), first_pixel(right), width, entity->color);
+    }
+  }
+  return 0;
+}
+
+bool compositor_place(struct framebuffer *framebuffer, const struct entity *entities, uint32_t num_entities, double ratio)
+{
+  // The lists trade places, the new entities go where the ones from two frames back were
+  if (num_entities > framebuffer->previous_entities_capacity)
+  {
+    struct placed_entity *placed = realloc(framebuffer->previous_entities, num_entities * sizeof(struct placed_entity));
+    if (placed == NULL)
+    {
+      return false;
+    }
+    framebuffer->previous_entities = placed;
+    framebuffer->previous_entities_capacity = num_entities;
+  }
+  struct placed_entity *previous = framebuffer->entities;
+  uint32_t previous_capacity = framebuffer->entities_capacity;
+  framebuffer->entities = framebuffer->previous_entities;
+  framebuffer->entities_capacity = framebuffer->previous_entities_capacity;
+  framebuffer->previous_entities = previous;
+  framebuffer->previous_entities_capacity = previous_capacity;
+  framebuffer->num_previous_entities = framebuffer->num_entities;
+  framebuffer->num_entities = 0;
+
+  float scale = (float)ratio;
+  for (uint32_t i = 0; i < num_entities; i++)
+  {
+    const struct entity *entity = &entities[i];
+    if (entity->kind > entity_triangle || entity->color.a == 0)
+    {
+      continue;
+    }
+    struct placed_entity placed = {entity->kind, entity->color, entity->x0 * scale, entity->y0 * scale, entity->x1 * scale, entity->y1 * scale,
+                                   entity->x2 * scale, entity->y2 * scale, entity->width * scale, {0, 0, 0, 0}};
+    float left, top, right, bottom;
+    switch (entity->kind)
+    {
+      case entity_circle:
+        left = placed.x0 - placed.width;
+        right = placed.x0 + placed.width;
+        top = placed.y0 - placed.width;
+        bottom = placed.y0 + placed.width;
+        break;
+      case entity_line:
+      {
+        // Becomes the filled rectangle it covers
+        float half = placed.width / 2;
+        bool horizontal = fabsf(placed.x1 - placed.x0) >= fabsf(placed.y1 - placed.y0);
+        left = horizontal ? min_float(placed.x0, placed.x1) : placed.x0 - half;
+        right = horizontal ? max_float(placed.x0, placed.x1) : placed.x0 + half;
+        top = horizontal ? placed.y0 - half : min_float(placed.y0, placed.y1);
+        bottom = horizontal ? placed.y0 + half : max_float(placed.y0, placed.y1);
+        placed.x0 = left;
+        placed.y0 = top;
+        placed.x1 = right;
+        placed.y1 = bottom;
+        placed.width = 0;
+        break;
+      }
+      case entity_rect:
+        left = min_float(placed.x0, placed.x1);
+        right = max_float(placed.x0, placed.x1);
+        top = min_float(placed.y0, placed.y1);
+        bottom = max_float(placed.y0, placed.y1);
+        placed.x0 = left;
+        placed.y0 = top;
+        placed.x1 = right;
+        placed.y1 = bottom;
+        break;
+      default:
+        left = min_float(placed.x0, min_float(placed.x1, placed.x2));
+        right = max_float(placed.x0, max_float(placed.x1, placed.x2));
+        top = min_float(placed.y0, min_float(placed.y1, placed.y2));
+        bottom = max_float(placed.y0, max_float(placed.y1, placed.y2));
+        break;
+    }
+    // Pixels whose centre can be inside, anything further out is never visited
+    int64_t x0 = clamp_pixel(first_pixel(left), framebuffer->width), x1 = clamp_pixel(first_pixel(right) + 1, framebuffer->width);
+    int64_t y0 = clamp_pixel(first_pixel(top), framebuffer->height), y1 = clamp_pixel(first_pixel(bottom) + 1, framebuffer->height);
+    if (x0 >= x1 || y0 >= y1)
+    {
+      continue;
+    }
+    placed.bounds = (struct rect){(uint32_t)x0, (uint32_t)y0, (uint32_t)(x1 - x0), (uint32_t)(y1 - y0)};
+    framebuffer->entities[framebuffer->num_entities++] = placed;
+  }
+  return true;
+}
+
+void compositor_draw_tile(const struct framebuffer *framebuffer, struct image_settings *settings)
+{
+  uint64_t first_row = settings->start_row << settings->scale_shift;
+  uint64_t end_row = settings->end_row << settings->scale_shift;
+  end_row = end_row < settings->output_height ? end_row : settings->output_height;
+  for (uint32_t i = 0; i < framebuffer->num_entities; i++)
+  {
+    const struct placed_entity *entity = &framebuffer->entities[i];
+    uint64_t top = entity->bounds.y > first_row ? entity->bounds.y : first_row;
+    uint64_t bottom = entity->bounds.y + entity->bounds.height < end_row ? entity->bounds.y + entity->bounds.height : end_row;
+    for (uint64_t y = top; y < bottom; y++)
+    {
+      settings->bytes_written += draw_row(entity, &settings->pixels[y * settings->stride], y, settings->output_width) * sizeof(struct rgba);
+    }
+  }
+}
+
+void compositor_extent(const struct placed_entity *entities, uint32_t num_entities, uint64_t first_row, uint64_t end_row, struct rect *extent)
+{
+  for (uint32_t i = 0; i < num_entities; i++)
+  {
+    const struct rect *bounds = &entities[i].bounds;
+    uint64_t top = bounds->y > first_row ? bounds->y : first_row;
+    uint64_t bottom = bounds->y + bounds->height < end_row ? bounds->y + bounds->height : end_row;
+    if (top >= bottom)
+    {
+      continue;
+    }
+    if (extent->width == 0 || extent->height == 0)
+    {
+      *extent = (struct rect){bounds->x, (uint32_t)top, bounds->width, (uint32_t)(bottom - top)};
+      continue;
+    }
+    uint64_t left = bounds->x < extent->x ? bounds->x : extent->x;
+    uint64_t right = bounds->x + bounds->width > extent->x + extent->width ? bounds->x + bounds->width : extent->x + extent->width;
+    uint64_t extent_top = top < extent->y ? top : extent->y;
+    uint64_t extent_bottom = bottom > extent->y + extent->height ? bottom : extent->y + extent->height;
+    *extent = (struct rect){(uint32_t)left, (uint32_t)extent_top, (uint32_t)(right - left), (uint32_t)(extent_bottom - extent_top)};
+  }
+}
+
+bool compositor_entity_equal(const struct entity *a, const struct entity *b)
+{
+  return a->kind == b->kind && rgba_equal(a->color, b->color) && a->x0 == b->x0 && a->y0 == b->y0 && a->x1 == b->x1 && a->y1 == b->y1 && a->x2 == b->x2 &&
+         a->y2 == b->y2 && a->width == b->width;
+}
+
+bool compositor_covers_tile(const struct placed_entity *entities, uint32_t num_entities, const struct image_settings *settings)
+{
+  uint64_t first_row = settings->start_row << settings->scale_shift;
+  uint64_t end_row = settings->end_row << settings->scale_shift;
+  for (uint32_t i = 0; i < num_entities; i++)
+  {
+    if (entities[i].bounds.y < end_row && entities[i].bounds.y + entities[i].bounds.height > first_row)
+    {
+      return true;
+    }
+  }
+  return false;
+}
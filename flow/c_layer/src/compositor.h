@@ -0,0 +1,30 @@
+#pragma once
+
+#include "c_layer.h"
+#include "framebuffer.h"
+
+// An entity scaled to output pixels for one frame
+struct placed_entity
+{
+    entity_kind kind;
+    struct rgba color;
+    float x0, y0, x1, y1, x2, y2;
+    float width;
+    // Output pixels the entity can touch, clipped to the frame, empty entities are not placed
+    struct rect bounds;
+};
+
+// Copies entities into the framebuffer at its output size, the ones it had become its previous entities.
+// Returns false when memory ran out, the framebuffer is then left as it was.
+bool compositor_place(struct framebuffer *framebuffer, const struct entity *entities, uint32_t num_entities, double ratio);
+
+// Draws every entity of the framebuffer over the output rows of the tile in settings, once its background is written.
+void compositor_draw_tile(const struct framebuffer *framebuffer, struct image_settings *settings);
+
+// Grows extent by the entities touching output rows first_row to end_row, within those rows.
+void compositor_extent(const struct placed_entity *entities, uint32_t num_entities, uint64_t first_row, uint64_t end_row, struct rect *extent);
+
+bool compositor_entity_equal(const struct entity *a, const struct entity *b);
+
+// Whether any of the entities touches the output rows of the tile in settings.
+bool compositor_covers_tile(const struct placed_entity *entities, uint32_t num_entities, const struct image_settings *settings);
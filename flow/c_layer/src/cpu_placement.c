@@ -0,0 +1,273 @@
+#if defined(__linux__)
+// Thread affinity and the batch and idle policies are GNU extensions
+#define _GNU_SOURCE
+#endif
+
+#include "cpu_placement.h"
+
+#if defined(__linux__)
+#include <errno.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+#define max_placement_cpus 64
+
+static uint32_t count_cpus(uint64_t mask)
+{
+  uint32_t count = 0;
+  for (; mask != 0; mask &= mask - 1)
+  {
+    count++;
+  }
+  return count;
+}
+
+// The mask with only its n-th CPU left, counting from the lowest
+static uint64_t nth_cpu(uint64_t mask, uint32_t n)
+{
+  for (; n > 0; n--)
+  {
+    mask &= mask - 1;
+  }
+  return mask & (~mask + 1);
+}
+
+#if defined(__linux__)
+static uint64_t cpu_set_to_mask(const cpu_set_t *set)
+{
+  uint64_t mask = 0;
+  for (int cpu = 0; cpu < max_placement_cpus; cpu++)
+  {
+    if (CPU_ISSET(cpu, set))
+    {
+      mask |= (uint64_t)1 << cpu;
+    }
+  }
+  return mask;
+}
+
+// Affinity of the process as a whole, the main thread's, since workers may already be narrowed down
+static uint64_t process_cpu_mask(void)
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  return sched_getaffinity(getpid(), sizeof(set), &set) == 0 ? cpu_set_to_mask(&set) : 0;
+}
+
+static bool read_numbers(const char *path, const char *format, char *text, double *number)
+{
+  FILE *file = fopen(path, "r");
+  if (file == NULL)
+  {
+    return false;
+  }
+  bool read = text != NULL ? fscanf(file, format, text, number) == 2 : fscanf(file, format, number) == 1;
+  fclose(file);
+  return read;
+}
+
+// CPUs worth of time the cgroup may use per period, zero without a quota
+static double cgroup_cpu_quota(void)
+{
+  char quota[32];
+  double period;
+  if (read_numbers("/sys/fs/cgroup/cpu.max", "%31s %lf", quota, &period))
+  {
+    return strcmp(quota, "max") == 0 || period <= 0 ? 0 : strtod(quota, NULL) / period;
+  }
+
+  // cgroup v1, where -1 means no quota
+  const char *const directories[] = {"/sys/fs/cgroup/cpu", "/sys/fs/cgroup/cpu,cpuacct"};
+  for (int i = 0; i < 2; i++)
+  {
+    char path[64];
+    double v1_quota, v1_period;
+    snprintf(path, sizeof(path), "%s/cpu.cfs_quota_us", directories[i]);
+    if (!read_numbers(path, "%lf", NULL, &v1_quota))
+    {
+      continue;
+    }
+    snprintf(path, sizeof(path), "%s/cpu.cfs_period_us", directories[i]);
+    if (read_numbers(path, "%lf", NULL, &v1_period) && v1_quota > 0 && v1_period > 0)
+    {
+      return v1_quota / v1_period;
+    }
+    return 0;
+  }
+  return 0;
+}
+
+static const int linux_policies[] = {
+  [worker_policy_default] = SCHED_OTHER,
+  [worker_policy_batch] = SCHED_BATCH,
+  [worker_policy_idle] = SCHED_IDLE,
+  [worker_policy_fifo] = SCHED_FIFO,
+  [worker_policy_round_robin] = SCHED_RR,
+};
+#elif _WIN32
+static uint64_t process_cpu_mask(void)
+{
+  DWORD_PTR process_mask, system_mask;
+  return GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask) ? (uint64_t)process_mask : 0;
+}
+
+static int windows_priority(const struct worker_placement *placement)
+{
+  if (placement->policy == worker_policy_fifo || placement->policy == worker_policy_round_robin)
+  {
+    return THREAD_PRIORITY_TIME_CRITICAL;
+  }
+  if (placement->policy == worker_policy_idle)
+  {
+    return THREAD_PRIORITY_IDLE;
+  }
+  // Nice values the way the Linux scheduler weighs them, roughly
+  if (placement->nice <= -10)
+  {
+    return THREAD_PRIORITY_HIGHEST;
+  }
+  if (placement->nice < 0)
+  {
+    return THREAD_PRIORITY_ABOVE_NORMAL;
+  }
+  if (placement->nice >= 10)
+  {
+    return THREAD_PRIORITY_LOWEST;
+  }
+  return placement->nice > 0 ? THREAD_PRIORITY_BELOW_NORMAL : THREAD_PRIORITY_NORMAL;
+}
+#else
+static uint64_t process_cpu_mask(void)
+{
+  return 0;
+}
+#endif
+
+// The CPUs the worker goes on, zero to leave its affinity alone
+static uint64_t select_cpus(const struct worker_placement *placement, uint32_t worker_index, int32_t caller_cpu)
+{
+  uint64_t allowed = process_cpu_mask();
+  uint64_t cpus = placement->cpu_mask != 0 ? placement->cpu_mask : allowed;
+  if (allowed != 0)
+  {
+    cpus &= allowed;
+  }
+
+  uint64_t reserved = placement->reserved_cpu_mask;
+  if (placement->reserve_caller_cpu && caller_cpu >= 0 && caller_cpu < max_placement_cpus)
+  {
+    reserved |= (uint64_t)1 << caller_cpu;
+  }
+  // Workers share the reserved CPUs rather than having nowhere to run
+  if ((cpus & ~reserved) != 0)
+  {
+    cpus &= ~reserved;
+  }
+
+  if (placement->pin && cpus != 0)
+  {
+    cpus = nth_cpu(cpus, worker_index % count_cpus(cpus));
+  }
+  return cpus;
+}
+
+void cpu_placement_apply(const struct worker_placement *placement, uint32_t worker_index, int32_t caller_cpu, struct worker_placement_status *status)
+{
+  uint64_t cpus = select_cpus(placement, worker_index, caller_cpu);
+  bool realtime = placement->policy == worker_policy_fifo || placement->policy == worker_policy_round_robin;
+  // Asking only for CPUs the process may not use leaves nothing to apply
+  status->applied = placement->policy <= worker_policy_round_robin && (cpus != 0 || placement->cpu_mask == 0);
+
+#if defined(__linux__)
+  if (cpus != 0)
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu = 0; cpu < max_placement_cpus; cpu++)
+    {
+      if (cpus & ((uint64_t)1 << cpu))
+      {
+        CPU_SET(cpu, &set);
+      }
+    }
+    // Zero is the calling thread, not the whole process
+    status->applied &= sched_setaffinity(0, sizeof(set), &set) == 0;
+  }
+
+  if (placement->policy <= worker_policy_round_robin)
+  {
+    struct sched_param parameters = {.sched_priority = realtime ? placement->priority : 0};
+    status->applied &= sched_setscheduler(0, linux_policies[placement->policy], &parameters) == 0;
+  }
+  // Threads have a nice value of their own, addressed by thread id
+  pid_t thread = (pid_t)syscall(SYS_gettid);
+  if (!realtime)
+  {
+    status->applied &= setpriority(PRIO_PROCESS, (id_t)thread, placement->nice) == 0;
+  }
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  status->cpu_mask = sched_getaffinity(0, sizeof(set), &set) == 0 ? cpu_set_to_mask(&set) : 0;
+  int policy = sched_getscheduler(0);
+  status->policy = worker_policy_default;
+  for (int i = worker_policy_default; i <= worker_policy_round_robin; i++)
+  {
+    if (linux_policies[i] == policy)
+    {
+      status->policy = i;
+    }
+  }
+  errno = 0;
+  int nice = getpriority(PRIO_PROCESS, (id_t)thread);
+  status->nice = errno == 0 ? nice : 0;
+  struct sched_param parameters;
+  status->priority = sched_getparam(0, &parameters) == 0 ? parameters.sched_priority : 0;
+#elif _WIN32
+  if (cpus != 0)
+  {
+    status->applied &= SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)cpus) != 0;
+  }
+  status->applied &= SetThreadPriority(GetCurrentThread(), windows_priority(placement)) != 0;
+
+  // Windows has no way to read a thread's affinity back, it is whatever was last set
+  status->cpu_mask = status->applied && cpus != 0 ? cpus : process_cpu_mask();
+  status->policy = placement->policy;
+  status->nice = realtime ? 0 : placement->nice;
+  status->priority = realtime ? placement->priority : 0;
+#else
+  // Nothing to apply with, only asking for the defaults counts as done
+  status->applied &= cpus == 0 && placement->policy == worker_policy_default && placement->nice == 0;
+  status->cpu_mask = 0;
+  status->policy = worker_policy_default;
+  status->nice = 0;
+  status->priority = 0;
+#endif
+}
+
+int32_t cpu_placement_current_cpu(void)
+{
+#if defined(__linux__)
+  return sched_getcpu();
+#elif _WIN32
+  return (int32_t)GetCurrentProcessorNumber();
+#else
+  return -1;
+#endif
+}
+
+uint32_t cpu_placement_usable_cpus(void)
+{
+  uint32_t cpus = count_cpus(process_cpu_mask());
+#if defined(__linux__)
+  // A quota of 1.5 CPUs still runs two workers, each for part of the time
+  double quota = cgroup_cpu_quota();
+  if (quota > 0 && (cpus == 0 || ceil(quota) < cpus))
+  {
+    cpus = (uint32_t)ceil(quota);
+  }
+#endif
+  return cpus;
+}
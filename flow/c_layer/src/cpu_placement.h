@@ -0,0 +1,12 @@
+#pragma once
+
+#include "c_layer.h"
+
+// Applies placement to the calling thread, the worker_index-th of the pool, and reads back what it got into status.
+void cpu_placement_apply(const struct worker_placement *placement, uint32_t worker_index, int32_t caller_cpu, struct worker_placement_status *status);
+
+// CPU the calling thread runs on right now, -1 when the system does not tell.
+int32_t cpu_placement_current_cpu(void);
+
+// CPUs the process may use within its affinity and cgroup quota, zero when neither can be read.
+uint32_t cpu_placement_usable_cpus(void);
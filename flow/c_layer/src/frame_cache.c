@@ -0,0 +1,151 @@
+#include "frame_cache.h"
+
+static void free_entry(struct frame_cache *cache, uint32_t index)
+{
+  struct frame_cache_entry *entry = &cache->entries[index];
+  free(entry->pixels);
+  free(entry->indices);
+  free(entry->rows);
+  cache->used_bytes -= entry->bytes;
+  // Order does not matter, the last entry fills the hole
+  cache->entries[index] = cache->entries[--cache->num_entries];
+}
+
+static void evict_until(struct frame_cache *cache, uint64_t bytes)
+{
+  while (cache->num_entries > 0 && cache->used_bytes + bytes > cache->budget_bytes)
+  {
+    uint32_t oldest = 0;
+    for (uint32_t i = 1; i < cache->num_entries; i++)
+    {
+      if (cache->entries[i].last_used < cache->entries[oldest].last_used)
+      {
+        oldest = i;
+      }
+    }
+    free_entry(cache, oldest);
+    cache->evictions++;
+  }
+}
+
+void frame_cache_create(struct frame_cache *cache, uint64_t budget_bytes)
+{
+  cache->entries = NULL;
+  cache->num_entries = 0;
+  cache->capacity = 0;
+  cache->budget_bytes = budget_bytes;
+  cache->used_bytes = 0;
+  cache->clock = 0;
+  cache->hits = 0;
+  cache->misses = 0;
+  cache->evictions = 0;
+}
+
+void frame_cache_set_budget(struct frame_cache *cache, uint64_t budget_bytes)
+{
+  cache->budget_bytes = budget_bytes;
+  evict_until(cache, 0);
+}
+
+struct frame_cache_entry *frame_cache_find(struct frame_cache *cache, const struct frame_inputs *inputs, bool count)
+{
+  // Entries are a few dozen full frames at most, a scan costs nothing next to copying one
+  for (uint32_t i = 0; i < cache->num_entries; i++)
+  {
+    if (frame_inputs_equal(cache->entries[i].inputs, *inputs))
+    {
+      cache->entries[i].last_used = ++cache->clock;
+      cache->hits += count;
+      return &cache->entries[i];
+    }
+  }
+  cache->misses += count;
+  return NULL;
+}
+
+bool frame_cache_store(struct frame_cache *cache, const struct frame_inputs *inputs, const struct framebuffer *framebuffer)
+{
+  if (frame_cache_find(cache, inputs, false) != NULL)
+  {
+    return true;
+  }
+
+  const struct frame_key *key = &framebuffer->key;
+  uint64_t pixels_size = key->width * key->height * sizeof(struct rgba);
+  uint64_t indices_size = key->render_width * key->render_height;
+  uint64_t rows_size = key->render_height * sizeof(struct row_state);
+  uint64_t bytes = pixels_size + indices_size + rows_size;
+  if (bytes > cache->budget_bytes)
+  {
+    return false;
+  }
+  evict_until(cache, bytes);
+
+  if (cache->num_entries == cache->capacity)
+  {
+    uint32_t capacity = cache->capacity > 0 ? cache->capacity * 2 : 16;
+    struct frame_cache_entry *entries = realloc(cache->entries, capacity * sizeof(struct frame_cache_entry));
+    if (entries == NULL)
+    {
+      return false;
+    }
+    cache->entries = entries;
+    cache->capacity = capacity;
+  }
+
+  struct frame_cache_entry entry = {*inputs, *key, malloc(pixels_size), malloc(indices_size), malloc(rows_size), bytes, ++cache->clock};
+  if (entry.pixels == NULL || entry.indices == NULL || entry.rows == NULL)
+  {
+    free(entry.pixels);
+    free(entry.indices);
+    free(entry.rows);
+    return false;
+  }
+  for (uint64_t y = 0; y < key->height; y++)
+  {
+    memcpy(&entry.pixels[y * key->width], &framebuffer->pixels[y * framebuffer->stride], key->width * sizeof(struct rgba));
+  }
+  for (uint64_t y = 0; y < key->render_height; y++)
+  {
+    memcpy(&entry.indices[y * key->render_width], &framebuffer->indices[y * framebuffer->stride], key->render_width);
+  }
+  memcpy(entry.rows, framebuffer->rows, rows_size);
+
+  cache->entries[cache->num_entries++] = entry;
+  cache->used_bytes += bytes;
+  return true;
+}
+
+void frame_cache_load(const struct frame_cache_entry *entry, struct framebuffer *framebuffer)
+{
+  const struct frame_key *key = &entry->key;
+  for (uint64_t y = 0; y < key->height; y++)
+  {
+    memcpy(&framebuffer->pixels[y * framebuffer->stride], &entry->pixels[y * key->width], key->width * sizeof(struct rgba));
+  }
+  for (uint64_t y = 0; y < key->render_height; y++)
+  {
+    memcpy(&framebuffer->indices[y * framebuffer->stride], &entry->indices[y * key->render_width], key->render_width);
+  }
+  memcpy(framebuffer->rows, entry->rows, key->render_height * sizeof(struct row_state));
+
+  // The buffer now holds exactly the cached frame, the next one can be rendered incrementally on top of it
+  framebuffer->key = *key;
+  framebuffer->key_valid = true;
+}
+
+void frame_cache_clear(struct frame_cache *cache)
+{
+  while (cache->num_entries > 0)
+  {
+    free_entry(cache, cache->num_entries - 1);
+  }
+}
+
+void frame_cache_destroy(struct frame_cache *cache)
+{
+  frame_cache_clear(cache);
+  free(cache->entries);
+  cache->entries = NULL;
+  cache->capacity = 0;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "c_layer.h"
+#include "framebuffer.h"
+
+// A finished frame kept for reuse, with everything a framebuffer needs to show it again and render incrementally on top of it.
+// Planes are packed, rows are the frame's width apart rather than a buffer's stride.
+struct frame_cache_entry
+{
+    struct frame_inputs inputs;
+    struct frame_key key;
+    struct rgba *pixels;
+    uint8_t *indices;
+    struct row_state *rows;
+    uint64_t bytes;
+    // Clock of the cache when the entry was last stored or found, the smallest is evicted first
+    uint64_t last_used;
+};
+
+// Frames by the inputs they were rendered from, least recently used first out once they take more than the budget.
+// Only touched by the caller of draw_background, never by the workers.
+struct frame_cache
+{
+    struct frame_cache_entry *entries;
+    uint32_t num_entries;
+    uint32_t capacity;
+    uint64_t budget_bytes;
+    uint64_t used_bytes;
+    uint64_t clock;
+    uint64_t hits, misses, evictions;
+};
+
+void frame_cache_create(struct frame_cache *cache, uint64_t budget_bytes);
+
+// Lowers or raises the budget, evicting until what is kept fits.
+void frame_cache_set_budget(struct frame_cache *cache, uint64_t budget_bytes);
+
+// The entry rendered from inputs, NULL when there is none. Counts a hit or a miss when count is set.
+struct frame_cache_entry *frame_cache_find(struct frame_cache *cache, const struct frame_inputs *inputs, bool count);
+
+// Copies a fully rendered framebuffer into the cache, returns false when it is larger than the whole budget or memory ran out.
+bool frame_cache_store(struct frame_cache *cache, const struct frame_inputs *inputs, const struct framebuffer *framebuffer);
+
+// Copies the entry into a framebuffer already reserved at the entry's size.
+void frame_cache_load(const struct frame_cache_entry *entry, struct framebuffer *framebuffer);
+
+void frame_cache_clear(struct frame_cache *cache);
+
+void frame_cache_destroy(struct frame_cache *cache);
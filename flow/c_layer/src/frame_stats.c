@@ -0,0 +1,51 @@
+#include "frame_stats.h"
+
+void frame_stats_ring_create(struct frame_stats_ring *ring)
+{
+  // Also empties a ring readers may still be copying from, every slot then fails their sequence check
+  atomic_store_explicit(&ring->count, 0, memory_order_release);
+  ring->dropped_frames = 0;
+  for (int i = 0; i < frame_stats_history; i++)
+  {
+    atomic_store_explicit(&ring->slots[i].sequence, 0, memory_order_release);
+  }
+}
+
+void frame_stats_publish(struct frame_stats_ring *ring, const struct frame_stats *stats)
+{
+  // The nth frame leaves its slot at sequence 2 * (n + 1), readers can tell it from an older or newer one
+  uint64_t index = atomic_load_explicit(&ring->count, memory_order_relaxed);
+  struct frame_stats_slot *slot = &ring->slots[index % frame_stats_history];
+  atomic_store_explicit(&slot->sequence, 2 * index + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  slot->stats = *stats;
+  atomic_store_explicit(&slot->sequence, 2 * (index + 1), memory_order_release);
+  atomic_store_explicit(&ring->count, index + 1, memory_order_release);
+}
+
+uint32_t frame_stats_read(struct frame_stats_ring *ring, struct frame_stats *stats, uint32_t capacity)
+{
+  uint64_t count = atomic_load_explicit(&ring->count, memory_order_acquire);
+  uint64_t available = count < frame_stats_history ? count : frame_stats_history;
+  uint64_t first = count - (available < capacity ? available : capacity);
+
+  // Oldest first, a slot overwritten while it is copied is skipped rather than waited for
+  uint32_t num_read = 0;
+  for (uint64_t index = first; index < count; index++)
+  {
+    struct frame_stats_slot *slot = &ring->slots[index % frame_stats_history];
+    uint64_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    if (sequence != 2 * (index + 1))
+    {
+      continue;
+    }
+    stats[num_read] = slot->stats;
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&slot->sequence, memory_order_relaxed) != sequence)
+    {
+      continue;
+    }
+    num_read++;
+  }
+  return num_read;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdatomic.h>
+
+#include "c_layer.h"
+
+// Written by present_frame only, sequence is odd while the stats are being replaced
+struct frame_stats_slot
+{
+    atomic_uint_fast64_t sequence;
+    struct frame_stats stats;
+};
+
+// The most recent presented frames, readable from any thread without blocking the renderer
+struct frame_stats_ring
+{
+    struct frame_stats_slot slots[frame_stats_history];
+    atomic_uint_fast64_t count;
+    // Dropped frame total when the previous frame was published
+    uint64_t dropped_frames;
+};
+
+void frame_stats_ring_create(struct frame_stats_ring *ring);
+
+void frame_stats_publish(struct frame_stats_ring *ring, const struct frame_stats *stats);
+
+uint32_t frame_stats_read(struct frame_stats_ring *ring, struct frame_stats *stats, uint32_t capacity);
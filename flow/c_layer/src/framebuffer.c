@@ -0,0 +1,289 @@
+#include "framebuffer.h"
+#include "trace.h"
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+void framebuffer_ring_create(struct framebuffer_ring *ring)
+{
+  atomic_init(&ring->mailbox, -1);
+  atomic_init(&ring->dropped_frames, 0);
+  atomic_init(&ring->generation, 0);
+  atomic_init(&ring->allocated_bytes, 0);
+  atomic_init(&ring->peak_allocated_bytes, 0);
+  ring->next_id = 1;
+  ring->displayed_valid = false;
+  ring->displayed_rows = NULL;
+  ring->displayed_rows_capacity = 0;
+  ring->displayed_entities = NULL;
+  ring->num_displayed_entities = 0;
+  ring->displayed_entities_capacity = 0;
+
+  // Nothing is allocated until the first frame tells how big it needs to be
+  for (int i = 0; i < num_framebuffers; i++)
+  {
+    struct framebuffer *framebuffer = &ring->buffers[i];
+    framebuffer->id = 0;
+    framebuffer->width = 0;
+    framebuffer->height = 0;
+    framebuffer->stride = 0;
+    framebuffer->capacity_width = 0;
+    framebuffer->capacity_height = 0;
+    framebuffer->key_valid = false;
+    framebuffer->generation = 0;
+    atomic_init(&framebuffer->abandoned, false);
+    framebuffer->num_dirty_rects = 0;
+    framebuffer->pixels = NULL;
+    framebuffer->indices = NULL;
+    framebuffer->rows = NULL;
+    framebuffer->dirty_rects = NULL;
+    framebuffer->entities = NULL;
+    framebuffer->num_entities = 0;
+    framebuffer->entities_capacity = 0;
+    framebuffer->previous_entities = NULL;
+    framebuffer->num_previous_entities = 0;
+    framebuffer->previous_entities_capacity = 0;
+    atomic_init(&framebuffer->state, framebuffer_free);
+  }
+}
+
+static void *allocate_plane(struct framebuffer_ring *ring, uint64_t size)
+{
+  void *plane = NULL;
+#if _WIN32
+  plane = _aligned_malloc(size, framebuffer_row_alignment);
+#else
+  // Large planes are aligned and padded to whole huge pages so the kernel can back them with some
+  uint64_t alignment = size >= framebuffer_huge_page_size ? framebuffer_huge_page_size : framebuffer_row_alignment;
+  size = (size + alignment - 1) / alignment * alignment;
+  if (posix_memalign(&plane, alignment, size) != 0)
+  {
+    return NULL;
+  }
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  if (alignment == framebuffer_huge_page_size)
+  {
+    madvise(plane, size, MADV_HUGEPAGE);
+  }
+#endif
+#endif
+  if (plane != NULL)
+  {
+    uint64_t allocated = atomic_fetch_add(&ring->allocated_bytes, size) + size;
+    uint64_t peak = atomic_load(&ring->peak_allocated_bytes);
+    while (allocated > peak && !atomic_compare_exchange_weak(&ring->peak_allocated_bytes, &peak, allocated))
+    {
+    }
+  }
+  return plane;
+}
+
+static void release_plane(struct framebuffer_ring *ring, void *plane, uint64_t size)
+{
+  if (plane == NULL)
+  {
+    return;
+  }
+#if _WIN32
+  _aligned_free(plane);
+#else
+  uint64_t alignment = size >= framebuffer_huge_page_size ? framebuffer_huge_page_size : framebuffer_row_alignment;
+  size = (size + alignment - 1) / alignment * alignment;
+  free(plane);
+#endif
+  atomic_fetch_sub(&ring->allocated_bytes, size);
+}
+
+static uint64_t grow_capacity(uint64_t capacity, uint64_t requested)
+{
+  // Grow by half again so a window being dragged larger does not reallocate on every frame
+  uint64_t grown = capacity + capacity / 2;
+  return requested > grown ? requested : grown;
+}
+
+static uint64_t plane_stride(uint64_t width)
+{
+  return (width + framebuffer_row_alignment - 1) / framebuffer_row_alignment * framebuffer_row_alignment;
+}
+
+static void release_framebuffer_planes(struct framebuffer_ring *ring, struct framebuffer *framebuffer)
+{
+  uint64_t stride = plane_stride(framebuffer->capacity_width);
+  uint64_t height = framebuffer->capacity_height;
+  release_plane(ring, framebuffer->pixels, stride * height * sizeof(struct rgba));
+  release_plane(ring, framebuffer->indices, stride * height);
+  release_plane(ring, framebuffer->rows, height * sizeof(struct row_state));
+  release_plane(ring, framebuffer->dirty_rects, ((height + tile_rows - 1) / tile_rows + 1) * sizeof(struct rect));
+  framebuffer->pixels = NULL;
+  framebuffer->indices = NULL;
+  framebuffer->rows = NULL;
+  framebuffer->dirty_rects = NULL;
+  framebuffer->capacity_width = 0;
+  framebuffer->capacity_height = 0;
+}
+
+bool framebuffer_reserve(struct framebuffer_ring *ring, struct framebuffer *framebuffer, uint64_t width, uint64_t height)
+{
+  if (width > framebuffer->capacity_width || height > framebuffer->capacity_height)
+  {
+    uint64_t capacity_width = width > framebuffer->capacity_width ? grow_capacity(framebuffer->capacity_width, width) : framebuffer->capacity_width;
+    uint64_t capacity_height = height > framebuffer->capacity_height ? grow_capacity(framebuffer->capacity_height, height) : framebuffer->capacity_height;
+    uint64_t stride = plane_stride(capacity_width);
+    // A byte count that wraps around would allocate a plane smaller than the rows written to it
+    if (stride < capacity_width || (capacity_height > 0 && stride > UINT64_MAX / sizeof(struct rgba) / capacity_height))
+    {
+      return false;
+    }
+    release_framebuffer_planes(ring, framebuffer);
+
+    framebuffer->pixels = allocate_plane(ring, stride * capacity_height * sizeof(struct rgba));
+    framebuffer->indices = allocate_plane(ring, stride * capacity_height);
+    framebuffer->rows = allocate_plane(ring, capacity_height * sizeof(struct row_state));
+    framebuffer->dirty_rects = allocate_plane(ring, ((capacity_height + tile_rows - 1) / tile_rows + 1) * sizeof(struct rect));
+    framebuffer->capacity_width = capacity_width;
+    framebuffer->capacity_height = capacity_height;
+    framebuffer->key_valid = false;
+    if (framebuffer->pixels == NULL || framebuffer->indices == NULL || framebuffer->rows == NULL || framebuffer->dirty_rects == NULL)
+    {
+      release_framebuffer_planes(ring, framebuffer);
+      return false;
+    }
+  }
+
+  if (height > ring->displayed_rows_capacity)
+  {
+    uint64_t capacity = grow_capacity(ring->displayed_rows_capacity, height);
+    release_plane(ring, ring->displayed_rows, ring->displayed_rows_capacity * sizeof(struct row_state));
+    ring->displayed_rows = allocate_plane(ring, capacity * sizeof(struct row_state));
+    ring->displayed_rows_capacity = ring->displayed_rows != NULL ? capacity : 0;
+    ring->displayed_valid = false;
+    if (ring->displayed_rows == NULL)
+    {
+      return false;
+    }
+  }
+
+  if (framebuffer->width != width || framebuffer->height != height)
+  {
+    framebuffer->key_valid = false;
+  }
+  framebuffer->width = width;
+  framebuffer->height = height;
+  // Rows keep the stride of the allocation, so shrinking the frame never moves them
+  framebuffer->stride = plane_stride(framebuffer->capacity_width);
+  return true;
+}
+
+struct framebuffer *framebuffer_acquire(struct framebuffer_ring *ring)
+{
+  uint64_t trace_started = trace_begin();
+  for (int i = 0; i < num_framebuffers; i++)
+  {
+    int expected = framebuffer_free;
+    if (atomic_compare_exchange_strong(&ring->buffers[i].state, &expected, framebuffer_rendering))
+    {
+      ring->buffers[i].id = ring->next_id++;
+      ring->buffers[i].generation = atomic_load(&ring->generation);
+      atomic_store(&ring->buffers[i].abandoned, false);
+      trace_end("acquire_framebuffer", trace_started, "frame_id", ring->buffers[i].id);
+      return &ring->buffers[i];
+    }
+  }
+  // Frame id 0 marks an attempt that found every buffer taken
+  trace_end("acquire_framebuffer", trace_started, "frame_id", 0);
+  return NULL;
+}
+
+void framebuffer_publish(struct framebuffer_ring *ring, struct framebuffer *framebuffer)
+{
+  atomic_store(&framebuffer->state, framebuffer_ready);
+
+  // Latest wins, a frame that was never picked up goes straight back to the free list
+  int stale = atomic_exchange(&ring->mailbox, (int)(framebuffer - ring->buffers));
+  if (stale >= 0)
+  {
+    atomic_store(&ring->buffers[stale].state, framebuffer_free);
+    atomic_fetch_add(&ring->dropped_frames, 1);
+  }
+}
+
+struct framebuffer *framebuffer_take_latest(struct framebuffer_ring *ring)
+{
+  int latest = atomic_exchange(&ring->mailbox, -1);
+  return latest >= 0 ? &ring->buffers[latest] : NULL;
+}
+
+void framebuffer_display(struct framebuffer *framebuffer)
+{
+  atomic_store(&framebuffer->state, framebuffer_displayed);
+}
+
+void framebuffer_supersede(struct framebuffer_ring *ring)
+{
+  atomic_fetch_add(&ring->generation, 1);
+}
+
+bool framebuffer_superseded(struct framebuffer_ring *ring, const struct framebuffer *framebuffer)
+{
+  // Checked between tiles, a late answer only costs one more tile
+  return atomic_load_explicit(&ring->generation, memory_order_relaxed) != framebuffer->generation;
+}
+
+void framebuffer_abandon(struct framebuffer_ring *ring, struct framebuffer *framebuffer)
+{
+  // Some rows hold the abandoned frame and some an older one, the next frame in this buffer is rendered in full
+  framebuffer->key_valid = false;
+  atomic_fetch_add(&ring->dropped_frames, 1);
+  atomic_store(&framebuffer->state, framebuffer_free);
+}
+
+struct framebuffer *framebuffer_find_displayed(struct framebuffer_ring *ring, uint64_t id)
+{
+  for (int i = 0; i < num_framebuffers; i++)
+  {
+    if (ring->buffers[i].id == id && atomic_load(&ring->buffers[i].state) == framebuffer_displayed)
+    {
+      return &ring->buffers[i];
+    }
+  }
+  return NULL;
+}
+
+bool framebuffer_release(struct framebuffer_ring *ring, uint64_t id)
+{
+  uint64_t trace_started = trace_begin();
+  bool released = false;
+  for (int i = 0; i < num_framebuffers && !released; i++)
+  {
+    int expected = framebuffer_displayed;
+    released = ring->buffers[i].id == id && atomic_compare_exchange_strong(&ring->buffers[i].state, &expected, framebuffer_free);
+  }
+  trace_end("release_framebuffer", trace_started, "frame_id", id);
+  return released;
+}
+
+void framebuffer_ring_destroy(struct framebuffer_ring *ring)
+{
+  for (int i = 0; i < num_framebuffers; i++)
+  {
+    release_framebuffer_planes(ring, &ring->buffers[i]);
+    free(ring->buffers[i].entities);
+    free(ring->buffers[i].previous_entities);
+    ring->buffers[i].entities = NULL;
+    ring->buffers[i].num_entities = 0;
+    ring->buffers[i].entities_capacity = 0;
+    ring->buffers[i].previous_entities = NULL;
+    ring->buffers[i].num_previous_entities = 0;
+    ring->buffers[i].previous_entities_capacity = 0;
+  }
+  free(ring->displayed_entities);
+  ring->displayed_entities = NULL;
+  ring->num_displayed_entities = 0;
+  ring->displayed_entities_capacity = 0;
+  release_plane(ring, ring->displayed_rows, ring->displayed_rows_capacity * sizeof(struct row_state));
+  ring->displayed_rows = NULL;
+  ring->displayed_rows_capacity = 0;
+  ring->displayed_valid = false;
+  atomic_store(&ring->mailbox, -1);
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stdatomic.h>
+
+#include "c_layer.h"
+
+#define num_framebuffers 3
+
+// Rows start on a cache line in both planes, so strides are a multiple of this many pixels
+#define framebuffer_row_alignment 64
+#define framebuffer_huge_page_size (2 * 1024 * 1024)
+
+typedef enum
+{
+    framebuffer_free,
+    framebuffer_rendering,
+    framebuffer_ready,
+    framebuffer_displayed
+} framebuffer_state;
+
+struct framebuffer
+{
+    uint64_t id;
+    uint64_t width, height;
+    // Pixels between the start of two rows, in both the RGBA and index planes
+    uint64_t stride;
+    // Size the planes can hold before they have to be reallocated
+    uint64_t capacity_width, capacity_height;
+    struct rgba *pixels;
+    // What renderers write, one palette index per pixel
+    uint8_t *indices;
+    atomic_int state;
+    // Generation of the ring when the frame was started, workers give up on it once the ring has moved on
+    uint64_t generation;
+    // Set by the worker that gave up, the frame is then missing tiles and is never presented
+    atomic_bool abandoned;
+    // Filled in while the frame is rendered, published once it is presented
+    struct frame_stats stats;
+    // When the last tile was done, the caller feeds it to the render scale controller once it takes the frame
+    uint64_t rendered_nanoseconds;
+    // What the frame was rendered from, the frame cache keeps it by them
+    struct frame_inputs inputs;
+    // Rendered ahead for the frame cache, stored there instead of being presented
+    bool warming;
+    // Relative to the frame presented before it, computed when the frame is started
+    struct frame_shift shift;
+    // Entities drawn over this frame, and the ones drawn over the frame the buffer held before, whose tiles are written again in full
+    struct placed_entity *entities;
+    uint32_t num_entities;
+    uint32_t entities_capacity;
+    struct placed_entity *previous_entities;
+    uint32_t num_previous_entities;
+    uint32_t previous_entities_capacity;
+    // Describes the current pixels, valid once the buffer has been fully rendered with key
+    struct frame_key key;
+    bool key_valid;
+    struct row_state *rows;
+    // Areas that differ from the previously displayed frame, one per band of tile_rows rows at most
+    struct rect *dirty_rects;
+    uint32_t num_dirty_rects;
+};
+
+// One buffer held by the consumer, one waiting in the mailbox and one being rendered.
+// Displayed buffers belong to the consumer until it hands them back by id.
+struct framebuffer_ring
+{
+    struct framebuffer buffers[num_framebuffers];
+    // Index of the most recent completed frame that has not been displayed yet, -1 when empty.
+    atomic_int mailbox;
+    uint64_t next_id;
+    // Rows of the last frame handed to the consumer, dirty rectangles are relative to it
+    struct frame_key displayed_key;
+    bool displayed_valid;
+    struct row_state *displayed_rows;
+    uint64_t displayed_rows_capacity;
+    // Entities of the last frame handed to the consumer, where they were shows the background again in the next one
+    struct placed_entity *displayed_entities;
+    uint32_t num_displayed_entities;
+    uint32_t displayed_entities_capacity;
+    atomic_uint_fast64_t dropped_frames;
+    // Moved on by a request that supersedes the frame being rendered
+    atomic_uint_fast64_t generation;
+    atomic_uint_fast64_t allocated_bytes;
+    atomic_uint_fast64_t peak_allocated_bytes;
+};
+
+void framebuffer_ring_create(struct framebuffer_ring *ring);
+
+bool framebuffer_reserve(struct framebuffer_ring *ring, struct framebuffer *framebuffer, uint64_t width, uint64_t height);
+
+struct framebuffer *framebuffer_acquire(struct framebuffer_ring *ring);
+
+void framebuffer_publish(struct framebuffer_ring *ring, struct framebuffer *framebuffer);
+
+struct framebuffer *framebuffer_take_latest(struct framebuffer_ring *ring);
+
+void framebuffer_display(struct framebuffer *framebuffer);
+
+void framebuffer_supersede(struct framebuffer_ring *ring);
+
+bool framebuffer_superseded(struct framebuffer_ring *ring, const struct framebuffer *framebuffer);
+
+void framebuffer_abandon(struct framebuffer_ring *ring, struct framebuffer *framebuffer);
+
+struct framebuffer *framebuffer_find_displayed(struct framebuffer_ring *ring, uint64_t id);
+
+bool framebuffer_release(struct framebuffer_ring *ring, uint64_t id);
+
+void framebuffer_ring_destroy(struct framebuffer_ring *ring);
@@ -0,0 +1,178 @@
+#include "geometry.h"
+
+static bool reserve_vertices(struct geometry_buffer *buffer, uint32_t count)
+{
+  if (buffer->frame.num_vertices + count <= buffer->vertex_capacity)
+  {
+    return true;
+  }
+  uint32_t capacity = buffer->vertex_capacity > 0 ? buffer->vertex_capacity * 2 : 1536;
+  while (capacity < buffer->frame.num_vertices + count)
+  {
+    capacity *= 2;
+  }
+  float *vertices = realloc(buffer->frame.vertices, capacity * 2 * sizeof(float));
+  if (vertices == NULL)
+  {
+    return false;
+  }
+  buffer->frame.vertices = vertices;
+  buffer->vertex_capacity = capacity;
+  return true;
+}
+
+static bool reserve_runs(struct geometry_buffer *buffer, uint32_t count)
+{
+  if (count <= buffer->run_capacity)
+  {
+    return true;
+  }
+  struct geometry_run *runs = realloc(buffer->runs, count * sizeof(struct geometry_run));
+  if (runs == NULL)
+  {
+    return false;
+  }
+  buffer->runs = runs;
+  struct geometry_run *next_runs = realloc(buffer->next_runs, count * sizeof(struct geometry_run));
+  if (next_runs == NULL)
+  {
+    return false;
+  }
+  buffer->next_runs = next_runs;
+  buffer->run_capacity = count;
+  return true;
+}
+
+// Two triangles covering the run from its first row up to end_row, in output pixels
+static bool emit_run(struct geometry_buffer *buffer, const struct image_settings *settings, const struct geometry_run *run, uint64_t end_row)
+{
+  if (!reserve_vertices(buffer, 6))
+  {
+    return false;
+  }
+  uint64_t scale = 1ULL << settings->scale_shift;
+  float left = (float)(run->span.start * scale);
+  float right = (float)(run->span.end * scale < settings->output_width ? run->span.end * scale : settings->output_width);
+  float top = (float)(run->first_row * scale);
+  float bottom = (float)(end_row * scale < settings->output_height ? end_row * scale : settings->output_height);
+  float *vertices = &buffer->frame.vertices[buffer->frame.num_vertices * 2];
+  const float corners[12] = {left, top, right, top, left, bottom, right, top, right, bottom, left, bottom};
+  memcpy(vertices, corners, sizeof(corners));
+  buffer->frame.num_vertices += 6;
+  return true;
+}
+
+void geometry_ring_create(struct geometry_ring *ring)
+{
+  for (int i = 0; i < num_geometry_buffers; i++)
+  {
+    struct geometry_buffer *buffer = &ring->buffers[i];
+    buffer->id = 0;
+    atomic_init(&buffer->held, false);
+    buffer->frame = (struct geometry_frame){0, 0, {0, 0, 0, 0}, {0, 0, 0, 0}, 0, NULL};
+    buffer->vertex_capacity = 0;
+    buffer->runs = NULL;
+    buffer->next_runs = NULL;
+    buffer->run_capacity = 0;
+  }
+}
+
+struct geometry_buffer *geometry_acquire(struct geometry_ring *ring, uint64_t id)
+{
+  for (int i = 0; i < num_geometry_buffers; i++)
+  {
+    bool expected = false;
+    if (atomic_compare_exchange_strong(&ring->buffers[i].held, &expected, true))
+    {
+      ring->buffers[i].id = id;
+      return &ring->buffers[i];
+    }
+  }
+  return NULL;
+}
+
+bool geometry_build(struct geometry_buffer *buffer, const struct background_registry *registry, const struct image_settings *settings)
+{
+  buffer->frame.width = settings->output_width;
+  buffer->frame.height = settings->output_height;
+  buffer->frame.background_color = settings->colors.background_color;
+  buffer->frame.line_color = settings->colors.line_color;
+  buffer->frame.num_vertices = 0;
+
+  uint32_t num_runs = 0;
+  struct span scratch[max_row_spans];
+  for (uint64_t y = 0; y < settings->height; y++)
+  {
+    uint32_t num_spans;
+    const struct span *spans = background_row_spans(registry, settings, y, scratch, &num_spans);
+    if (!reserve_runs(buffer, num_runs + num_spans))
+    {
+      return false;
+    }
+
+    // Both lists are ordered, a run goes on while the row has the very same span and is closed otherwise
+    uint32_t run_index = 0, span_index = 0, num_next = 0;
+    while (run_index < num_runs || span_index < num_spans)
+    {
+      struct geometry_run *run = run_index < num_runs ? &buffer->runs[run_index] : NULL;
+      const struct span *span = span_index < num_spans ? &spans[span_index] : NULL;
+      if (run != NULL && span != NULL && run->span.start == span->start && run->span.end == span->end)
+      {
+        buffer->next_runs[num_next++] = *run;
+        run_index++;
+        span_index++;
+      }
+      else if (run != NULL && (span == NULL || run->span.start < span->start))
+      {
+        if (!emit_run(buffer, settings, run, y))
+        {
+          return false;
+        }
+        run_index++;
+      }
+      else
+      {
+        buffer->next_runs[num_next++] = (struct geometry_run){*span, y};
+        span_index++;
+      }
+    }
+    struct geometry_run *runs = buffer->runs;
+    buffer->runs = buffer->next_runs;
+    buffer->next_runs = runs;
+    num_runs = num_next;
+  }
+
+  for (uint32_t run_index = 0; run_index < num_runs; run_index++)
+  {
+    if (!emit_run(buffer, settings, &buffer->runs[run_index], settings->height))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool geometry_release(struct geometry_ring *ring, uint64_t id)
+{
+  for (int i = 0; i < num_geometry_buffers; i++)
+  {
+    if (ring->buffers[i].id == id && atomic_load(&ring->buffers[i].held))
+    {
+      atomic_store(&ring->buffers[i].held, false);
+      return true;
+    }
+  }
+  return false;
+}
+
+void geometry_ring_destroy(struct geometry_ring *ring)
+{
+  for (int i = 0; i < num_geometry_buffers; i++)
+  {
+    struct geometry_buffer *buffer = &ring->buffers[i];
+    free(buffer->frame.vertices);
+    free(buffer->runs);
+    free(buffer->next_runs);
+  }
+  geometry_ring_create(ring);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdatomic.h>
+
+#include "c_layer.h"
+#include "background.h"
+
+#define num_geometry_buffers 3
+
+// A run of line colored pixels that has continued unchanged since first_row
+struct geometry_run
+{
+    struct span span;
+    uint64_t first_row;
+};
+
+struct geometry_buffer
+{
+    uint64_t id;
+    // Set from the moment the frame is built until the consumer releases it
+    atomic_bool held;
+    struct geometry_frame frame;
+    uint32_t vertex_capacity;
+    // Runs still open at the previous row and the ones carried to the next, swapped every row
+    struct geometry_run *runs, *next_runs;
+    uint32_t run_capacity;
+};
+
+// Frames handed out as geometry, built and handed out by the caller of draw_background, released from wherever the consumer is
+struct geometry_ring
+{
+    struct geometry_buffer buffers[num_geometry_buffers];
+};
+
+void geometry_ring_create(struct geometry_ring *ring);
+
+// A buffer the consumer does not hold, given id, NULL when it holds all of them
+struct geometry_buffer *geometry_acquire(struct geometry_ring *ring, uint64_t id);
+
+// Turns the rows of a prepared background into rectangles, runs that stay the same from row to row become one.
+// Returns false when memory ran out, the buffer is then still acquired.
+bool geometry_build(struct geometry_buffer *buffer, const struct background_registry *registry, const struct image_settings *settings);
+
+bool geometry_release(struct geometry_ring *ring, uint64_t id);
+
+void geometry_ring_destroy(struct geometry_ring *ring);
@@ -0,0 +1,169 @@
+#include "grid.h"
+#include "kernels.h"
+
+const struct background grid_background = {"grid", grid_create, grid_prepare, grid_render_tile, grid_free, background_input_x_offset | background_input_y_offset, grid_shift, grid_line_spans};
+
+void *grid_create(void)
+{
+  return calloc(1, sizeof(struct grid_templates));
+}
+
+bool grid_prepare(void *state, const struct image_settings *settings)
+{
+  int total_x_offset = settings->x_offset + square_size / 2;
+  struct grid_templates *templates = state;
+  if (templates->rows != NULL && templates->width == settings->width && templates->x_offset == total_x_offset && templates->sample_scale == settings->sample_scale &&
+      rgba_equal(templates->background_color, settings->colors.background_color) && rgba_equal(templates->line_color, settings->colors.line_color))
+  {
+    return true;
+  }
+
+  if (templates->rows == NULL || templates->width != settings->width)
+  {
+    free(templates->rows);
+    free(templates->mask);
+    free(templates->spans);
+    templates->rows = malloc(num_grid_row_kinds * settings->width * sizeof(struct rgba));
+    templates->mask = malloc(num_grid_row_kinds * settings->width);
+    templates->spans = malloc(num_grid_row_kinds * grid_template_max_spans(settings->width) * sizeof(struct span));
+    if (templates->rows == NULL || templates->mask == NULL || templates->spans == NULL)
+    {
+      free(templates->rows);
+      free(templates->mask);
+      free(templates->spans);
+      templates->rows = NULL;
+      templates->mask = NULL;
+      templates->spans = NULL;
+      return false;
+    }
+  }
+  templates->width = settings->width;
+  templates->x_offset = total_x_offset;
+  templates->sample_scale = settings->sample_scale;
+  templates->background_color = settings->colors.background_color;
+  templates->line_color = settings->colors.line_color;
+
+  // Rows only differ by whether they hold a horizontal line and whether they cross a vertical dash
+  int square_dash_size = square_size / 3;
+  for (int kind = 0; kind < num_grid_row_kinds; kind++)
+  {
+    bool horizontal_line = kind & 1;
+    bool vertical_space = kind & 2;
+    for (uint64_t x = 0; x < templates->width; x++)
+    {
+      int true_x = abs((int)floor(x * templates->sample_scale) - total_x_offset) ;
+      bool vertical_line = true_x % square_size >= 0 && true_x % square_size < square_stroke_thickness;
+      bool horizontal_space = (true_x + square_dash_size / 4) % square_dash_size >= 0 && (true_x + square_dash_size / 4) % square_dash_size < square_dash_size / 2;
+      templates->mask[kind * templates->width + x] = (horizontal_line && horizontal_space) || (vertical_line && vertical_space) ? palette_line : palette_background;
+    }
+    kernels.expand_mask(&templates->rows[kind * templates->width], &templates->mask[kind * templates->width], templates->width, templates->background_color, templates->line_color, false);
+
+    // The same row as runs, for frames handed out as geometry
+    const uint8_t *mask = grid_template_indices(templates, kind);
+    struct span *spans = &templates->spans[kind * grid_template_max_spans(templates->width)];
+    uint32_t num_spans = 0;
+    for (uint32_t x = 0; x < templates->width; x++)
+    {
+      if (mask[x] == palette_line && (x == 0 || mask[x - 1] != palette_line))
+      {
+        spans[num_spans++] = (struct span){x, x + 1};
+      }
+      else if (mask[x] == palette_line)
+      {
+        spans[num_spans - 1].end = x + 1;
+      }
+    }
+    templates->num_spans[kind] = num_spans;
+  }
+  return true;
+}
+
+void grid_render_tile(const void *state, struct image_settings *settings)
+{
+  const struct grid_templates *templates = state;
+
+  for (uint64_t y = settings->start_row; y < settings->end_row; y++)
+  {
+    uint32_t template_index = grid_row_template(settings, y);
+
+    struct row_state *row_state = &settings->rows[y];
+    bool same_template = settings->incremental && row_state->kind == row_kind_grid_template && row_state->template_index == template_index;
+    if (same_template && !settings->expand)
+    {
+      continue;
+    }
+    if (!same_template)
+    {
+      memcpy(&settings->indices[y * settings->stride], grid_template_indices(templates, template_index), settings->width);
+      row_state->kind = row_kind_grid_template;
+      row_state->template_index = template_index;
+      row_state->num_spans = 0;
+    }
+    if (settings->scale_shift == 0)
+    {
+      // Templates are already in the frame's colors, so a recolored row is a plain copy
+      uint64_t first, end;
+      strip_columns(settings, y, &first, &end);
+      kernels.copy_row(&settings->pixels[y * settings->stride + first], grid_template_row(templates, template_index) + first, end - first, !settings->incremental);
+      settings->bytes_written += (end - first) * sizeof(struct rgba);
+    }
+    else
+    {
+      emit_scaled_row(settings, y, 0, settings->width);
+    }
+  }
+}
+
+void grid_free(void *state)
+{
+  struct grid_templates *templates = state;
+  free(templates->rows);
+  free(templates->mask);
+  free(templates->spans);
+  free(templates);
+}
+
+bool grid_shift(const struct frame_inputs *from, const struct frame_inputs *to, double *dx, double *dy)
+{
+  // Every pixel is a function of its position minus the offsets, the whole grid moves with them
+  *dx = (double)(to->x_offset - from->x_offset);
+  *dy = (double)(to->y_offset - from->y_offset);
+  return true;
+}
+
+const struct span *grid_line_spans(const void *state, const struct image_settings *settings, uint64_t y, struct span scratch[max_row_spans], uint32_t *num_spans)
+{
+  // Dashed rows have far more runs than scratch holds, they are kept with the templates
+  (void)scratch;
+  const struct grid_templates *templates = state;
+  uint32_t template_index = grid_row_template(settings, y);
+  *num_spans = templates->num_spans[template_index];
+  return &templates->spans[template_index * grid_template_max_spans(templates->width)];
+}
+
+uint32_t grid_row_template(const struct image_settings *settings, uint64_t y)
+{
+  int square_dash_size = square_size / 3;
+  int total_y_offset = settings->y_offset + square_size / 2;
+  // Rows are sampled at the logical position of their first pixel
+  int true_y = abs((int)floor(y * settings->sample_scale) - total_y_offset);
+  bool horizontal_line = true_y % square_size >= 0 && true_y % square_size < square_stroke_thickness;
+  bool vertical_space = (true_y + square_dash_size / 4) % square_dash_size >= 0 && (true_y + square_dash_size / 4) % square_dash_size < square_dash_size / 2;
+  return (horizontal_line ? 1 : 0) | (vertical_space ? 2 : 0);
+}
+
+uint64_t grid_template_max_spans(uint64_t width)
+{
+  // Runs are separated by at least one pixel
+  return width / 2 + 1;
+}
+
+const struct rgba *grid_template_row(const struct grid_templates *templates, uint32_t template_index)
+{
+  return &templates->rows[template_index * templates->width];
+}
+
+const uint8_t *grid_template_indices(const struct grid_templates *templates, uint32_t template_index)
+{
+  return &templates->mask[template_index * templates->width];
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "background.h"
+
+// Every distinct grid row for the current width, x offset and colors
+struct grid_templates
+{
+    uint64_t width;
+    int x_offset;
+    double sample_scale;
+    struct rgba background_color;
+    struct rgba line_color;
+    struct rgba *rows;
+    // Palette indices of every template row
+    uint8_t *mask;
+    // Line colored runs of every template row, grid_template_max_spans apart
+    struct span *spans;
+    uint32_t num_spans[num_grid_row_kinds];
+};
+
+extern const struct background grid_background;
+
+void *grid_create(void);
+
+bool grid_prepare(void *state, const struct image_settings *settings);
+
+void grid_render_tile(const void *state, struct image_settings *settings);
+
+void grid_free(void *state);
+
+bool grid_shift(const struct frame_inputs *from, const struct frame_inputs *to, double *dx, double *dy);
+
+const struct span *grid_line_spans(const void *state, const struct image_settings *settings, uint64_t y, struct span scratch[max_row_spans], uint32_t *num_spans);
+
+uint32_t grid_row_template(const struct image_settings *settings, uint64_t y);
+
+uint64_t grid_template_max_spans(uint64_t width);
+
+const struct rgba *grid_template_row(const struct grid_templates *templates, uint32_t template_index);
+
+const uint8_t *grid_template_indices(const struct grid_templates *templates, uint32_t template_index);
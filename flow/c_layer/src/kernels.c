@@ -0,0 +1,345 @@
+#include "kernels.h"
+
+#if KERNELS_X86
+#include <immintrin.h>
+#if _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+#if KERNELS_X86 && (__GNUC__ || __clang__)
+#define KERNELS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define KERNELS_TARGET_AVX2
+#endif
+
+static uint32_t pack_rgba(struct rgba color)
+{
+  uint32_t packed;
+  memcpy(&packed, &color, sizeof(packed));
+  return packed;
+}
+
+// ------------------------------------------------------------ scalar ------------------------------------------------------------ //
+
+static void fill_span_scalar(struct rgba *dst, uint64_t count, struct rgba color, bool stream)
+{
+  (void)stream;
+  for (uint64_t i = 0; i < count; i++)
+  {
+    dst[i] = color;
+  }
+}
+
+static void copy_row_scalar(struct rgba *dst, const struct rgba *src, uint64_t count, bool stream)
+{
+  (void)stream;
+  memcpy(dst, src, count * sizeof(struct rgba));
+}
+
+static void expand_mask_scalar(struct rgba *dst, const uint8_t *mask, uint64_t count, struct rgba off_color, struct rgba on_color, bool stream)
+{
+  (void)stream;
+  for (uint64_t i = 0; i < count; i++)
+  {
+    dst[i] = mask[i] ? on_color : off_color;
+  }
+}
+
+static void fence_none(void)
+{
+}
+
+// Scalar pixels written until dst reaches the requested alignment, streaming stores need aligned addresses.
+static uint64_t head_to_alignment(const struct rgba *dst, uint64_t count, uintptr_t alignment)
+{
+  uintptr_t misalignment = (uintptr_t)dst & (alignment - 1);
+  if (misalignment == 0)
+  {
+    return 0;
+  }
+  if (misalignment % sizeof(struct rgba) != 0)
+  {
+    return count;
+  }
+  uint64_t head = (alignment - misalignment) / sizeof(struct rgba);
+  return head < count ? head : count;
+}
+
+// ------------------------------------------------------------ SSE2 ------------------------------------------------------------ //
+
+#if KERNELS_X86
+static void fill_span_sse2(struct rgba *dst, uint64_t count, struct rgba color, bool stream)
+{
+  uint64_t i = 0;
+  __m128i value = _mm_set1_epi32((int)pack_rgba(color));
+  if (stream)
+  {
+    uint64_t head = head_to_alignment(dst, count, 16);
+    fill_span_scalar(dst, head, color, false);
+    for (i = head; i + 4 <= count; i += 4)
+    {
+      _mm_stream_si128((__m128i *)&dst[i], value);
+    }
+  }
+  else
+  {
+    for (; i + 4 <= count; i += 4)
+    {
+      _mm_storeu_si128((__m128i *)&dst[i], value);
+    }
+  }
+  fill_span_scalar(&dst[i], count - i, color, false);
+}
+
+static void copy_row_sse2(struct rgba *dst, const struct rgba *src, uint64_t count, bool stream)
+{
+  if (!stream)
+  {
+    copy_row_scalar(dst, src, count, false);
+    return;
+  }
+
+  uint64_t head = head_to_alignment(dst, count, 16);
+  copy_row_scalar(dst, src, head, false);
+  uint64_t i = head;
+  for (; i + 4 <= count; i += 4)
+  {
+    _mm_stream_si128((__m128i *)&dst[i], _mm_loadu_si128((const __m128i *)&src[i]));
+  }
+  copy_row_scalar(&dst[i], &src[i], count - i, false);
+}
+
+static void expand_mask_sse2(struct rgba *dst, const uint8_t *mask, uint64_t count, struct rgba off_color, struct rgba on_color, bool stream)
+{
+  __m128i off = _mm_set1_epi32((int)pack_rgba(off_color));
+  __m128i on = _mm_set1_epi32((int)pack_rgba(on_color));
+  __m128i zero = _mm_setzero_si128();
+
+  uint64_t i = stream ? head_to_alignment(dst, count, 16) : 0;
+  expand_mask_scalar(dst, mask, i, off_color, on_color, false);
+  for (; i + 16 <= count; i += 16)
+  {
+    // 0xff bytes where the mask is off, widened to one 32 bit lane per pixel
+    __m128i is_off = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)&mask[i]), zero);
+    __m128i low = _mm_unpacklo_epi8(is_off, is_off);
+    __m128i high = _mm_unpackhi_epi8(is_off, is_off);
+    __m128i lanes[4] = {
+      _mm_unpacklo_epi16(low, low),
+      _mm_unpackhi_epi16(low, low),
+      _mm_unpacklo_epi16(high, high),
+      _mm_unpackhi_epi16(high, high)
+    };
+    for (int lane = 0; lane < 4; lane++)
+    {
+      __m128i pixels = _mm_or_si128(_mm_and_si128(lanes[lane], off), _mm_andnot_si128(lanes[lane], on));
+      if (stream)
+      {
+        _mm_stream_si128((__m128i *)&dst[i + lane * 4], pixels);
+      }
+      else
+      {
+        _mm_storeu_si128((__m128i *)&dst[i + lane * 4], pixels);
+      }
+    }
+  }
+  expand_mask_scalar(&dst[i], &mask[i], count - i, off_color, on_color, false);
+}
+
+static void fence_sse2(void)
+{
+  _mm_sfence();
+}
+
+// ------------------------------------------------------------ AVX2 ------------------------------------------------------------ //
+
+KERNELS_TARGET_AVX2 static void fill_span_avx2(struct rgba *dst, uint64_t count, struct rgba color, bool stream)
+{
+  uint64_t i = 0;
+  __m256i value = _mm256_set1_epi32((int)pack_rgba(color));
+  if (stream)
+  {
+    uint64_t head = head_to_alignment(dst, count, 32);
+    fill_span_scalar(dst, head, color, false);
+    for (i = head; i + 8 <= count; i += 8)
+    {
+      _mm256_stream_si256((__m256i *)&dst[i], value);
+    }
+  }
+  else
+  {
+    for (; i + 8 <= count; i += 8)
+    {
+      _mm256_storeu_si256((__m256i *)&dst[i], value);
+    }
+  }
+  fill_span_scalar(&dst[i], count - i, color, false);
+}
+
+KERNELS_TARGET_AVX2 static void copy_row_avx2(struct rgba *dst, const struct rgba *src, uint64_t count, bool stream)
+{
+  if (!stream)
+  {
+    copy_row_scalar(dst, src, count, false);
+    return;
+  }
+
+  uint64_t head = head_to_alignment(dst, count, 32);
+  copy_row_scalar(dst, src, head, false);
+  uint64_t i = head;
+  for (; i + 8 <= count; i += 8)
+  {
+    _mm256_stream_si256((__m256i *)&dst[i], _mm256_loadu_si256((const __m256i *)&src[i]));
+  }
+  copy_row_scalar(&dst[i], &src[i], count - i, false);
+}
+
+KERNELS_TARGET_AVX2 static void expand_mask_avx2(struct rgba *dst, const uint8_t *mask, uint64_t count, struct rgba off_color, struct rgba on_color, bool stream)
+{
+  __m256i off = _mm256_set1_epi32((int)pack_rgba(off_color));
+  __m256i on = _mm256_set1_epi32((int)pack_rgba(on_color));
+  __m256i zero = _mm256_setzero_si256();
+
+  uint64_t i = stream ? head_to_alignment(dst, count, 32) : 0;
+  expand_mask_scalar(dst, mask, i, off_color, on_color, false);
+  for (; i + 8 <= count; i += 8)
+  {
+    __m256i lanes = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)&mask[i]));
+    __m256i pixels = _mm256_blendv_epi8(on, off, _mm256_cmpeq_epi32(lanes, zero));
+    if (stream)
+    {
+      _mm256_stream_si256((__m256i *)&dst[i], pixels);
+    }
+    else
+    {
+      _mm256_storeu_si256((__m256i *)&dst[i], pixels);
+    }
+  }
+  expand_mask_scalar(&dst[i], &mask[i], count - i, off_color, on_color, false);
+}
+
+static bool cpu_has_avx2(void)
+{
+#if _MSC_VER
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7)
+  {
+    return false;
+  }
+  __cpuid(info, 1);
+  bool os_saves_ymm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+  __cpuidex(info, 7, 0);
+  return os_saves_ymm && (info[1] & (1 << 5));
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+// ------------------------------------------------------------ NEON ------------------------------------------------------------ //
+
+#if KERNELS_NEON
+// NEON has no non-temporal store intrinsic, stream is ignored on this path.
+static void fill_span_neon(struct rgba *dst, uint64_t count, struct rgba color, bool stream)
+{
+  uint32x4_t value = vdupq_n_u32(pack_rgba(color));
+  uint64_t i = 0;
+  for (; i + 4 <= count; i += 4)
+  {
+    vst1q_u32((uint32_t *)&dst[i], value);
+  }
+  fill_span_scalar(&dst[i], count - i, color, false);
+}
+
+static void copy_row_neon(struct rgba *dst, const struct rgba *src, uint64_t count, bool stream)
+{
+  uint64_t i = 0;
+  for (; i + 4 <= count; i += 4)
+  {
+    vst1q_u32((uint32_t *)&dst[i], vld1q_u32((const uint32_t *)&src[i]));
+  }
+  copy_row_scalar(&dst[i], &src[i], count - i, false);
+}
+
+static void expand_mask_neon(struct rgba *dst, const uint8_t *mask, uint64_t count, struct rgba off_color, struct rgba on_color, bool stream)
+{
+  uint32x4_t off = vdupq_n_u32(pack_rgba(off_color));
+  uint32x4_t on = vdupq_n_u32(pack_rgba(on_color));
+  uint64_t i = 0;
+  for (; i + 8 <= count; i += 8)
+  {
+    // 0xff bytes where the mask is set, sign extended to one 32 bit lane per pixel
+    int8x8_t is_on = vreinterpret_s8_u8(vtst_u8(vld1_u8(&mask[i]), vdup_n_u8(0xff)));
+    int16x8_t wide = vmovl_s8(is_on);
+    uint32x4_t low = vreinterpretq_u32_s32(vmovl_s16(vget_low_s16(wide)));
+    uint32x4_t high = vreinterpretq_u32_s32(vmovl_s16(vget_high_s16(wide)));
+    vst1q_u32((uint32_t *)&dst[i], vbslq_u32(low, on, off));
+    vst1q_u32((uint32_t *)&dst[i + 4], vbslq_u32(high, on, off));
+  }
+  expand_mask_scalar(&dst[i], &mask[i], count - i, off_color, on_color, false);
+}
+#endif
+
+// ------------------------------------------------------------ dispatch ------------------------------------------------------------ //
+
+struct kernels kernels = {kernel_isa_scalar, fill_span_scalar, copy_row_scalar, expand_mask_scalar, fence_none};
+
+bool kernels_supported(kernel_isa isa)
+{
+  switch (isa)
+  {
+    case kernel_isa_scalar: return true;
+#if KERNELS_X86
+    case kernel_isa_sse2: return true;
+    case kernel_isa_avx2: return cpu_has_avx2();
+#endif
+#if KERNELS_NEON
+    case kernel_isa_neon: return true;
+#endif
+    default: return false;
+  }
+}
+
+kernel_isa kernels_select(kernel_isa isa)
+{
+  if (isa == kernel_isa_auto || !kernels_supported(isa))
+  {
+    // Best available, in order of preference
+    kernel_isa preferred[] = {kernel_isa_avx2, kernel_isa_neon, kernel_isa_sse2, kernel_isa_scalar};
+    for (int i = 0; i < (int)(sizeof(preferred) / sizeof(preferred[0])); i++)
+    {
+      if (kernels_supported(preferred[i]))
+      {
+        isa = preferred[i];
+        break;
+      }
+    }
+  }
+
+  switch (isa)
+  {
+#if KERNELS_X86
+    case kernel_isa_sse2:
+      kernels = (struct kernels){kernel_isa_sse2, fill_span_sse2, copy_row_sse2, expand_mask_sse2, fence_sse2};
+      break;
+    case kernel_isa_avx2:
+      kernels = (struct kernels){kernel_isa_avx2, fill_span_avx2, copy_row_avx2, expand_mask_avx2, fence_sse2};
+      break;
+#endif
+#if KERNELS_NEON
+    case kernel_isa_neon:
+      kernels = (struct kernels){kernel_isa_neon, fill_span_neon, copy_row_neon, expand_mask_neon, fence_none};
+      break;
+#endif
+    default:
+      kernels = (struct kernels){kernel_isa_scalar, fill_span_scalar, copy_row_scalar, expand_mask_scalar, fence_none};
+      break;
+  }
+  return kernels.isa;
+}
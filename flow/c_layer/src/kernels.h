@@ -0,0 +1,28 @@
+#pragma once
+
+#include "c_layer.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || (defined(__i386__) && defined(__SSE2__))
+#define KERNELS_X86 1
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define KERNELS_NEON 1
+#endif
+
+// Pixel write primitives, one implementation per instruction set picked at runtime.
+// Streaming variants bypass the cache and must be followed by fence() before the frame is handed out.
+struct kernels
+{
+    kernel_isa isa;
+    void (*fill_span)(struct rgba *dst, uint64_t count, struct rgba color, bool stream);
+    void (*copy_row)(struct rgba *dst, const struct rgba *src, uint64_t count, bool stream);
+    void (*expand_mask)(struct rgba *dst, const uint8_t *mask, uint64_t count, struct rgba off_color, struct rgba on_color, bool stream);
+    void (*fence)(void);
+};
+
+extern struct kernels kernels;
+
+bool kernels_supported(kernel_isa isa);
+
+kernel_isa kernels_select(kernel_isa isa);
@@ -0,0 +1,131 @@
+#include "perf_counters.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+struct perf_counter_event
+{
+    uint32_t type;
+    uint64_t config;
+};
+
+static const struct perf_counter_event perf_counter_events[num_perf_counters] = {
+  [perf_cycles] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+  [perf_instructions] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+  [perf_llc_misses] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+  [perf_stalled_cycles] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND},
+};
+
+// Layout of a group read with PERF_FORMAT_TOTAL_TIME_ENABLED and PERF_FORMAT_TOTAL_TIME_RUNNING
+struct perf_group_read
+{
+    uint64_t num_values;
+    uint64_t time_enabled;
+    uint64_t time_running;
+    uint64_t values[num_perf_counters];
+};
+
+static int perf_event_open(const struct perf_counter_event *event, int group)
+{
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = event->type;
+  attr.config = event->config;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  // User space only, which is all an unprivileged process may count with the default perf_event_paranoid
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.disabled = group < 0;
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+#endif
+
+uint32_t perf_counters_open(struct perf_counters *counters)
+{
+  counters->opened = true;
+  counters->available = 0;
+  counters->leader = -1;
+  counters->num_open = 0;
+  for (int i = 0; i < num_perf_counters; i++)
+  {
+    counters->fds[i] = -1;
+  }
+
+#if defined(__linux__)
+  for (int i = 0; i < num_perf_counters; i++)
+  {
+    int fd = perf_event_open(&perf_counter_events[i], counters->leader);
+    if (fd < 0)
+    {
+      // Not permitted, or not something this processor counts
+      continue;
+    }
+    if (counters->leader < 0)
+    {
+      counters->leader = fd;
+    }
+    counters->fds[i] = fd;
+    counters->order[counters->num_open++] = i;
+    counters->available |= 1u << i;
+  }
+
+  if (counters->leader >= 0 && ioctl(counters->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) != 0)
+  {
+    perf_counters_close(counters);
+  }
+#endif
+  return counters->available;
+}
+
+void perf_counters_read(const struct perf_counters *counters, uint64_t values[num_perf_counters])
+{
+  for (int i = 0; i < num_perf_counters; i++)
+  {
+    values[i] = 0;
+  }
+
+#if defined(__linux__)
+  if (counters->leader < 0)
+  {
+    return;
+  }
+  struct perf_group_read group;
+  if (read(counters->leader, &group, sizeof(group)) < (ssize_t)(3 * sizeof(uint64_t)) || group.num_values != counters->num_open || group.time_running == 0)
+  {
+    return;
+  }
+  // More counters than the processor has registers are multiplexed, extrapolate to the whole time they were enabled
+  double scale = group.time_running < group.time_enabled ? (double)group.time_enabled / group.time_running : 1;
+  for (uint32_t i = 0; i < counters->num_open; i++)
+  {
+    values[counters->order[i]] = scale == 1 ? group.values[i] : (uint64_t)(group.values[i] * scale);
+  }
+#endif
+}
+
+void perf_counters_close(struct perf_counters *counters)
+{
+  if (!counters->opened)
+  {
+    return;
+  }
+#if defined(__linux__)
+  for (int i = 0; i < num_perf_counters; i++)
+  {
+    if (counters->fds[i] >= 0)
+    {
+      close(counters->fds[i]);
+    }
+  }
+#endif
+  for (int i = 0; i < num_perf_counters; i++)
+  {
+    counters->fds[i] = -1;
+  }
+  counters->leader = -1;
+  counters->num_open = 0;
+  counters->available = 0;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "c_layer.h"
+
+// Hardware counters of the thread that opened them, read as one group so the values belong to the same instant.
+// Only Linux has them, elsewhere and wherever perf_event_open is refused nothing opens and reads are all zero.
+struct perf_counters
+{
+    // Set once opening was attempted, a refused counter is not asked for again
+    bool opened;
+    // Bit i set when counter i is counting
+    uint32_t available;
+    int leader;
+    int fds[num_perf_counters];
+    // Counter each value of a group read belongs to, in the order they joined the group
+    perf_counter order[num_perf_counters];
+    uint32_t num_open;
+};
+
+// Opens whichever counters the system permits for the calling thread, returns the mask of those that count.
+uint32_t perf_counters_open(struct perf_counters *counters);
+
+// Current totals since opening, zero for the counters that are not available.
+void perf_counters_read(const struct perf_counters *counters, uint64_t values[num_perf_counters]);
+
+void perf_counters_close(struct perf_counters *counters);
@@ -0,0 +1,52 @@
+#include "../c_layer.h"
+
+#include <stdio.h>
+
+// Frames delivered since the test last looked, handed straight back
+static uint32_t delivered_frames;
+
+static void release_frame_callback(uint64_t frame_id, uint64_t width, uint64_t height, uint64_t row_bytes, uint64_t data_size, void *data)
+{
+  (void)width, (void)height, (void)row_bytes, (void)data_size, (void)data;
+  delivered_frames++;
+  release_frame(frame_id);
+}
+
+static int failures;
+
+static void expect(bool condition, const char *what)
+{
+  if (!condition)
+  {
+    fprintf(stderr, "FAILED: %s\n", what);
+    failures++;
+  }
+}
+
+// A request started asynchronously and dropped by going back to synchronous rendering is still rendered when asked for again
+static void async_to_sync_renders_the_dropped_request(void)
+{
+  initialize(release_frame_callback, 64, 48, 2);
+  set_render_mode(render_async);
+  delivered_frames = 0;
+  expect(draw_background(10, 0, 0) == draw_started, "async frame starts");
+
+  set_render_mode(render_sync);
+  expect(draw_background(10, 0, 0) == draw_started, "same request renders again after switching to sync");
+  expect(delivered_frames == 1, "the synchronous frame is delivered");
+
+  expect(draw_background(10, 0, 0) == draw_unchanged, "a frame already shown is not rendered again");
+  expect(delivered_frames == 1, "nothing more is delivered for it");
+  shutdown();
+}
+
+int main(void)
+{
+  async_to_sync_renders_the_dropped_request();
+  if (failures > 0)
+  {
+    return 1;
+  }
+  printf("render_mode_test passed\n");
+  return 0;
+}
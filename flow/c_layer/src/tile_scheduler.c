@@ -0,0 +1,59 @@
+#include "tile_scheduler.h"
+
+#include <stdlib.h>
+
+bool tile_scheduler_create(struct tile_scheduler *scheduler, uint32_t num_queues)
+{
+  scheduler->queues = calloc(num_queues, sizeof(struct tile_queue));
+  if (scheduler->queues == NULL)
+  {
+    scheduler->num_queues = 0;
+    return false;
+  }
+
+  scheduler->num_queues = num_queues;
+  for (uint32_t i = 0; i < num_queues; i++)
+  {
+    atomic_init(&scheduler->queues[i].next, 0);
+    scheduler->queues[i].end = 0;
+  }
+  return true;
+}
+
+void tile_scheduler_reset(struct tile_scheduler *scheduler, uint64_t num_tiles)
+{
+  // Called before the workers are woken up, the pool's mutex publishes the new ranges.
+  for (uint32_t i = 0; i < scheduler->num_queues; i++)
+  {
+    atomic_store_explicit(&scheduler->queues[i].next, i * num_tiles / scheduler->num_queues, memory_order_relaxed);
+    scheduler->queues[i].end = (i + 1) * num_tiles / scheduler->num_queues;
+  }
+}
+
+bool tile_scheduler_next(struct tile_scheduler *scheduler, uint32_t worker_index, uint64_t *tile)
+{
+  // Start with our own range, then walk the other workers' ranges in order.
+  for (uint32_t i = 0; i < scheduler->num_queues; i++)
+  {
+    struct tile_queue *queue = &scheduler->queues[(worker_index + i) % scheduler->num_queues];
+    if (atomic_load_explicit(&queue->next, memory_order_relaxed) >= queue->end)
+    {
+      continue;
+    }
+
+    uint64_t candidate = atomic_fetch_add_explicit(&queue->next, 1, memory_order_relaxed);
+    if (candidate < queue->end)
+    {
+      *tile = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+void tile_scheduler_destroy(struct tile_scheduler *scheduler)
+{
+  free(scheduler->queues);
+  scheduler->queues = NULL;
+  scheduler->num_queues = 0;
+}
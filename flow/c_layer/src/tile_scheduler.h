@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#define tile_queue_size 64
+
+// A contiguous range of tiles owned by one worker, other workers steal from its front once their own range is empty.
+struct tile_queue
+{
+    atomic_uint_fast64_t next;
+    uint64_t end;
+    // Keeps the cursors of two workers off the same cache line.
+    uint8_t padding[tile_queue_size - sizeof(atomic_uint_fast64_t) - sizeof(uint64_t)];
+};
+
+struct tile_scheduler
+{
+    uint32_t num_queues;
+    struct tile_queue *queues;
+};
+
+bool tile_scheduler_create(struct tile_scheduler *scheduler, uint32_t num_queues);
+
+void tile_scheduler_reset(struct tile_scheduler *scheduler, uint64_t num_tiles);
+
+bool tile_scheduler_next(struct tile_scheduler *scheduler, uint32_t worker_index, uint64_t *tile);
+
+void tile_scheduler_destroy(struct tile_scheduler *scheduler);
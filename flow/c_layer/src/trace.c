@@ -0,0 +1,230 @@
+#include "trace.h"
+
+static struct trace trace;
+static once_flag trace_once = ONCE_FLAG_INIT;
+static tss_t trace_buffer_key;
+
+static void trace_release_buffer(void *buffer)
+{
+  atomic_store(&((struct trace_buffer *)buffer)->owned, false);
+}
+
+static void trace_create_key(void)
+{
+  tss_create(&trace_buffer_key, trace_release_buffer);
+}
+
+static struct trace_buffer *trace_new_buffer(void)
+{
+  struct trace_buffer *buffer = malloc(sizeof(struct trace_buffer));
+  if (buffer == NULL)
+  {
+    return NULL;
+  }
+  atomic_init(&buffer->epoch, atomic_load(&trace.epoch));
+  atomic_init(&buffer->count, 0);
+  atomic_init(&buffer->owned, true);
+  buffer->thread_id = atomic_fetch_add(&trace.next_thread_id, 1) + 1;
+  buffer->thread_name[0] = '\0';
+
+  struct trace_buffer *head = atomic_load(&trace.buffers);
+  do
+  {
+    buffer->next = head;
+  } while (!atomic_compare_exchange_weak(&trace.buffers, &head, buffer));
+  return buffer;
+}
+
+// The buffer of the calling thread, reusing one left by an exited thread whose events are no longer needed
+static struct trace_buffer *trace_thread_buffer(void)
+{
+  struct trace_buffer *buffer = tss_get(trace_buffer_key);
+  if (buffer != NULL)
+  {
+    return buffer;
+  }
+
+  uint64_t epoch = atomic_load(&trace.epoch);
+  for (buffer = atomic_load(&trace.buffers); buffer != NULL; buffer = buffer->next)
+  {
+    bool owned = false;
+    if ((atomic_load(&buffer->epoch) != epoch || atomic_load(&buffer->count) == 0) && atomic_compare_exchange_strong(&buffer->owned, &owned, true))
+    {
+      atomic_store(&buffer->count, 0);
+      atomic_store(&buffer->epoch, epoch);
+      buffer->thread_name[0] = '\0';
+      break;
+    }
+  }
+  if (buffer == NULL)
+  {
+    buffer = trace_new_buffer();
+  }
+  if (buffer != NULL)
+  {
+    tss_set(trace_buffer_key, buffer);
+  }
+  return buffer;
+}
+
+static void trace_append(struct trace_buffer *buffer, const struct trace_event *event)
+{
+  uint64_t epoch = atomic_load_explicit(&trace.epoch, memory_order_relaxed);
+  if (atomic_load_explicit(&buffer->epoch, memory_order_relaxed) != epoch)
+  {
+    atomic_store_explicit(&buffer->count, 0, memory_order_relaxed);
+    atomic_store_explicit(&buffer->epoch, epoch, memory_order_relaxed);
+  }
+
+  uint32_t count = atomic_load_explicit(&buffer->count, memory_order_relaxed);
+  if (count == trace_buffer_events)
+  {
+    atomic_fetch_add_explicit(&trace.dropped_events, 1, memory_order_relaxed);
+    return;
+  }
+  buffer->events[count] = *event;
+  // Published after the event itself, trace_write never reads past count
+  atomic_store_explicit(&buffer->count, count + 1, memory_order_release);
+}
+
+void trace_start(void)
+{
+  call_once(&trace_once, trace_create_key);
+  // Every buffer starts over with the next event it records
+  atomic_fetch_add(&trace.epoch, 1);
+  atomic_store(&trace.dropped_events, 0);
+  atomic_store(&trace.enabled, true);
+}
+
+void trace_stop(void)
+{
+  atomic_store(&trace.enabled, false);
+}
+
+bool trace_enabled(void)
+{
+  return atomic_load_explicit(&trace.enabled, memory_order_relaxed);
+}
+
+uint64_t trace_begin(void)
+{
+  return trace_enabled() ? monotonic_nanoseconds() : 0;
+}
+
+void trace_end(const char *name, uint64_t start, const char *argument_name, uint64_t argument)
+{
+  if (start == 0 || !trace_enabled())
+  {
+    return;
+  }
+  struct trace_buffer *buffer = trace_thread_buffer();
+  if (buffer != NULL)
+  {
+    struct trace_event event = {name, argument_name, argument, start, monotonic_nanoseconds() - start};
+    trace_append(buffer, &event);
+  }
+}
+
+void trace_thread_name(const char *name, int index)
+{
+  if (!trace_enabled())
+  {
+    return;
+  }
+  struct trace_buffer *buffer = trace_thread_buffer();
+  if (buffer != NULL && buffer->thread_name[0] == '\0')
+  {
+    if (index < 0)
+    {
+      snprintf(buffer->thread_name, trace_thread_name_size, "%s", name);
+    }
+    else
+    {
+      snprintf(buffer->thread_name, trace_thread_name_size, "%s %d", name, index);
+    }
+  }
+}
+
+void trace_record_dart(const char *name, uint64_t start, uint64_t end)
+{
+  if (!trace_enabled() || end < start)
+  {
+    return;
+  }
+  if (trace.dart_buffer == NULL)
+  {
+    trace.dart_buffer = trace_new_buffer();
+    if (trace.dart_buffer == NULL)
+    {
+      return;
+    }
+    snprintf(trace.dart_buffer->thread_name, trace_thread_name_size, "dart");
+  }
+  struct trace_event event = {name, NULL, 0, start, end - start};
+  trace_append(trace.dart_buffer, &event);
+}
+
+static void write_json_string(FILE *file, const char *string)
+{
+  fputc('"', file);
+  for (; *string != '\0'; string++)
+  {
+    if (*string == '"' || *string == '\\')
+    {
+      fputc('\\', file);
+    }
+    if ((unsigned char)*string >= 0x20)
+    {
+      fputc(*string, file);
+    }
+  }
+  fputc('"', file);
+}
+
+bool trace_write(const char *path)
+{
+  FILE *file = fopen(path, "w");
+  if (file == NULL)
+  {
+    return false;
+  }
+
+  // Chrome trace-event format, timestamps in microseconds
+  uint64_t epoch = atomic_load(&trace.epoch);
+  bool first = true;
+  fprintf(file, "{\"traceEvents\":[");
+  for (struct trace_buffer *buffer = atomic_load(&trace.buffers); buffer != NULL; buffer = buffer->next)
+  {
+    if (atomic_load(&buffer->epoch) != epoch)
+    {
+      continue;
+    }
+    uint32_t count = atomic_load_explicit(&buffer->count, memory_order_acquire);
+    if (buffer->thread_name[0] != '\0')
+    {
+      fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",", buffer->thread_id);
+      write_json_string(file, buffer->thread_name);
+      fprintf(file, "}}");
+      first = false;
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+      const struct trace_event *event = &buffer->events[i];
+      fprintf(file, "%s\n{\"name\":", first ? "" : ",");
+      write_json_string(file, event->name);
+      fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f", buffer->thread_id, event->start / 1e3, event->duration / 1e3);
+      if (event->argument_name != NULL)
+      {
+        fprintf(file, ",\"args\":{");
+        write_json_string(file, event->argument_name);
+        fprintf(file, ":%llu}", (unsigned long long)event->argument);
+      }
+      fputc('}', file);
+      first = false;
+    }
+  }
+  fprintf(file, "\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":%llu}}\n", (unsigned long long)atomic_load(&trace.dropped_events));
+
+  bool written = !ferror(file);
+  return fclose(file) == 0 && written;
+}
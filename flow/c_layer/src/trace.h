@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdatomic.h>
+
+#include "c_layer.h"
+
+// Events each thread can hold before the next ones are dropped
+#define trace_buffer_events (1 << 16)
+#define trace_thread_name_size 32
+
+// A scoped event, written as a Chrome trace complete event
+struct trace_event
+{
+    const char *name;
+    // Optional, argument is only written when there is a name for it
+    const char *argument_name;
+    uint64_t argument;
+    uint64_t start;
+    uint64_t duration;
+};
+
+// Only written by the thread that owns it, so recording never takes a lock
+struct trace_buffer
+{
+    struct trace_buffer *next;
+    // Trace the events belong to, a buffer left from an earlier one starts over with its next event
+    atomic_uint_fast64_t epoch;
+    atomic_uint_fast32_t count;
+    // Cleared when the owning thread exits, another thread may then take the buffer over
+    atomic_bool owned;
+    uint32_t thread_id;
+    char thread_name[trace_thread_name_size];
+    struct trace_event events[trace_buffer_events];
+};
+
+struct trace
+{
+    atomic_bool enabled;
+    atomic_uint_fast64_t epoch;
+    // Every buffer ever created, only ever pushed to
+    _Atomic(struct trace_buffer *) buffers;
+    atomic_uint_fast32_t next_thread_id;
+    atomic_uint_fast64_t dropped_events;
+    // Events recorded from Dart, which only ever calls in from one thread at a time
+    struct trace_buffer *dart_buffer;
+};
+
+void trace_start(void);
+
+void trace_stop(void);
+
+bool trace_enabled(void);
+
+// Start time of a scoped event, zero when tracing is off so trace_end has nothing to do
+uint64_t trace_begin(void);
+
+void trace_end(const char *name, uint64_t start, const char *argument_name, uint64_t argument);
+
+// Names the calling thread in the trace followed by index unless it is negative, only the first name given sticks
+void trace_thread_name(const char *name, int index);
+
+void trace_record_dart(const char *name, uint64_t start, uint64_t end);
+
+bool trace_write(const char *path);
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+
+// Angles are fractions of a turn, the full 32 bit range being one turn
+#define trig_quarter_turn (1u << 30)
+// Results are in Q30, trig_one stands for 1.0
+#define trig_one (1 << 30)
+#define trig_quarter_segments 256
+
+// Quarter wave table with linear interpolation, integer only so every platform returns the same bits.
+// |trig_sin(phase) / 2^30 - sin(2 pi phase / 2^32)| < 4.8e-6, the interpolation error of (pi / 512)^2 / 8 plus rounding.
+int32_t trig_sin(uint32_t phase);
+
+int32_t trig_cos(uint32_t phase);
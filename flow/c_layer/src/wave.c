@@ -0,0 +1,184 @@
+#include "wave.h"
+#include "trig.h"
+
+// Bands drawn around the wave, adding one only adds one span per row
+static const struct range wave_bands[] = {
+  {-80, 0.5},
+  {-60, 1.0},
+  {-40, 2.0},
+  {-20, 3.0},
+  {0, 4.0},
+  {20, 3.0},
+  {40, 2.0},
+  {60, 1.0},
+  {80, 1.0}
+};
+
+// 2^48 / (400 pi) and twice that, one cycle of the tilt every 400 pi frames and of the frequency every 200 pi
+#define wave_angle_turns 223990669501ULL
+#define wave_frequency_turns 447981339002ULL
+// 0.01 and 0.005 radians per pixel as Q40 turns
+#define wave_base_frequency 1749927105LL
+#define wave_frequency_swing 874963553LL
+
+#define wave_offset 100
+#define wave_amplitude 30
+
+_Static_assert(sizeof(wave_bands) / sizeof(wave_bands[0]) == num_wave_bands, "num_wave_bands must match the band table");
+_Static_assert(num_wave_bands <= max_row_spans, "every wave band must fit in a row_state");
+
+const struct background wave_background = {"wave", wave_create, wave_prepare, wave_render_tile, wave_free, background_input_cycle_time, wave_shift, wave_line_spans};
+
+void *wave_create(void)
+{
+  struct wave_state *wave = calloc(1, sizeof(struct wave_state));
+  if (wave == NULL)
+  {
+    return NULL;
+  }
+  for (int band_index = 0; band_index < num_wave_bands; band_index++)
+  {
+    wave->bands[band_index].low = (int64_t)((wave_bands[band_index].offset - wave_bands[band_index].tolerance) * 65536);
+    wave->bands[band_index].high = (int64_t)((wave_bands[band_index].offset + wave_bands[band_index].tolerance) * 65536);
+  }
+  return wave;
+}
+
+bool wave_prepare(void *state, const struct image_settings *settings)
+{
+  // Everything the wave draws is integer arithmetic so every platform draws the same pixels.
+  // Positions are Q16 logical pixels, angles are fractions of a turn as trig_sin takes them.
+  struct wave_state *wave = state;
+  uint64_t logical_width = settings->logical_width > 0 ? settings->logical_width : 1;
+
+  // Phases of cycle / 200 and cycle / 100 radians, the multipliers are 2^16 turns so the product keeps its sub-turn bits
+  wave->angle = trig_sin((uint32_t)((settings->cycle_time * wave_angle_turns) >> 16)) / 2;                 // Oscillates between -0.5 and 0.5 in Q30
+  int64_t frequency_sin = trig_sin((uint32_t)((settings->cycle_time * wave_frequency_turns) >> 16));
+  wave->frequency = wave_base_frequency + ((wave_frequency_swing * frequency_sin) >> 30);                  // 0.005 to 0.015 radians per pixel, as Q40 turns
+  wave->scroll = ((int64_t)wave_offset << 16) + (int64_t)(((settings->cycle_time % (20 * logical_width)) << 16) / 20); // Smooth horizontal scroll
+
+  wave->sample_scale = (int64_t)(settings->sample_scale * 65536 + 0.5);
+  wave->inverse_scale = (int64_t)(65536 / settings->sample_scale + 0.5);
+  return true;
+}
+
+void wave_render_tile(const void *state, struct image_settings *settings)
+{
+  const struct wave_state *wave = state;
+  struct span spans[num_wave_bands];
+
+  for (uint64_t y = settings->start_row; y < settings->end_row; y++)
+  {
+    int num_spans = wave_spans_at_row(wave, y, settings->width, spans);
+
+    struct row_state *row_state = &settings->rows[y];
+    uint8_t *indices = &settings->indices[y * settings->stride];
+    // Full scale rows that keep their colors get the few changed pixels written directly
+    bool write_in_place = !settings->expand && settings->scale_shift == 0;
+    if (settings->incremental && row_state->kind == row_kind_spans)
+    {
+      struct span changed;
+      uint32_t changed_pixels = update_row_spans(indices, write_in_place ? &settings->pixels[y * settings->stride] : NULL, row_state, spans, num_spans, &settings->colors, &changed);
+      if (settings->expand)
+      {
+        emit_row(settings, y);
+      }
+      else if (write_in_place)
+      {
+        settings->bytes_written += changed_pixels * sizeof(struct rgba);
+      }
+      else if (changed_pixels > 0)
+      {
+        emit_scaled_row(settings, y, changed.start, changed.end);
+      }
+    }
+    else
+    {
+      fill_row_spans(indices, settings->width, spans, num_spans);
+      emit_row(settings, y);
+    }
+    store_row_spans(row_state, spans, num_spans);
+  }
+}
+
+void wave_free(void *state)
+{
+  free(state);
+}
+
+bool wave_shift(const struct frame_inputs *from, const struct frame_inputs *to, double *dx, double *dy)
+{
+  // The scroll as wave_prepare computes it, the tilt and the frequency change with the cycle time as well so the wave never only moves
+  uint64_t logical_width = to->width > 0 ? to->width : 1;
+  int64_t from_scroll = (int64_t)(((from->cycle_time % (20 * logical_width)) << 16) / 20);
+  int64_t to_scroll = (int64_t)(((to->cycle_time % (20 * logical_width)) << 16) / 20);
+  *dx = (to_scroll - from_scroll) / 65536.0;
+  *dy = 0;
+  return false;
+}
+
+const struct span *wave_line_spans(const void *state, const struct image_settings *settings, uint64_t y, struct span scratch[max_row_spans], uint32_t *num_spans)
+{
+  *num_spans = wave_spans_at_row(state, y, settings->width, scratch);
+  return scratch;
+}
+
+int wave_spans_at_row(const struct wave_state *wave, uint64_t y, uint64_t width, struct span *spans)
+{
+  // The wave only moves along y, every band of the row is resolved once then filled as runs
+  int64_t logical_y = y * wave->sample_scale;
+  int64_t tilt = (wave->angle * logical_y) >> 30;
+  uint32_t phase = (uint32_t)(((uint64_t)logical_y * (uint64_t)wave->frequency) >> 24);
+  int64_t swing = ((int64_t)wave_amplitude * trig_sin(phase)) >> 14;
+  int64_t wave_x = ((int64_t)wave_offset << 16) + wave->scroll + tilt + swing;
+  return wave_row_spans(wave, wave_x, width, spans);
+}
+
+int wave_row_spans(const struct wave_state *wave, int64_t wave_x, uint64_t width, struct span *spans)
+{
+  int num_spans = 0;
+  for (int band_index = 0; band_index < num_wave_bands; band_index++)
+  {
+    // Same bounds as an inclusive test of every integer x against base + offset -/+ tolerance
+    int64_t low = (wave_x + wave->bands[band_index].low) * wave->inverse_scale >> 16;
+    int64_t high = (wave_x + wave->bands[band_index].high) * wave->inverse_scale >> 16;
+    int64_t first = -(-low >> 16);
+    int64_t last = high >> 16;
+    if (last < 0 || first >= (int64_t)width || first > last)
+    {
+      continue;
+    }
+
+    struct span span;
+    span.start = first < 0 ? 0 : (uint32_t)first;
+    span.end = last + 1 > (int64_t)width ? (uint32_t)width : (uint32_t)last + 1;
+
+    // Insertion sort, the table is small and nearly always already ordered
+    int insert_index = num_spans;
+    while (insert_index > 0 && spans[insert_index - 1].start > span.start)
+    {
+      spans[insert_index] = spans[insert_index - 1];
+      insert_index--;
+    }
+    spans[insert_index] = span;
+    num_spans++;
+  }
+
+  // Merge overlapping or touching bands
+  int merged = 0;
+  for (int span_index = 0; span_index < num_spans; span_index++)
+  {
+    if (merged > 0 && spans[span_index].start <= spans[merged - 1].end)
+    {
+      if (spans[span_index].end > spans[merged - 1].end)
+      {
+        spans[merged - 1].end = spans[span_index].end;
+      }
+    }
+    else
+    {
+      spans[merged++] = spans[span_index];
+    }
+  }
+  return merged;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "background.h"
+
+#define num_wave_bands 9
+
+// Pixels of a band, relative to the wave's centre, in Q16 logical pixels
+struct wave_band
+{
+    int64_t low, high;
+};
+
+struct wave_state
+{
+    struct wave_band bands[num_wave_bands];
+    // Derived from the cycle time once per frame, in the fixed point formats wave_render_tile works with
+    int64_t angle;
+    int64_t frequency;
+    int64_t scroll;
+    int64_t sample_scale;
+    int64_t inverse_scale;
+};
+
+extern const struct background wave_background;
+
+void *wave_create(void);
+
+bool wave_prepare(void *state, const struct image_settings *settings);
+
+void wave_render_tile(const void *state, struct image_settings *settings);
+
+void wave_free(void *state);
+
+bool wave_shift(const struct frame_inputs *from, const struct frame_inputs *to, double *dx, double *dy);
+
+const struct span *wave_line_spans(const void *state, const struct image_settings *settings, uint64_t y, struct span scratch[max_row_spans], uint32_t *num_spans);
+
+int wave_spans_at_row(const struct wave_state *wave, uint64_t y, uint64_t width, struct span *spans);
+
+int wave_row_spans(const struct wave_state *wave, int64_t wave_x, uint64_t width, struct span *spans);
@@ -0,0 +1,181 @@
+#include "worker_pool.h"
+
+#include <stdlib.h>
+
+bool worker_pool_start(struct worker_pool *pool, uint32_t num_workers)
+{
+  pool->num_workers = 0;
+  pool->generation = 0;
+  pool->busy_workers = 0;
+  pool->job = NULL;
+  pool->job_done_callback = NULL;
+  pool->job_data = NULL;
+  pool->stopping = false;
+
+  if (mtx_init(&pool->mutex, mtx_plain) != thrd_success)
+  {
+    return false;
+  }
+  if (cnd_init(&pool->job_ready) != thrd_success)
+  {
+    mtx_destroy(&pool->mutex);
+    return false;
+  }
+  if (cnd_init(&pool->job_done) != thrd_success)
+  {
+    cnd_destroy(&pool->job_ready);
+    mtx_destroy(&pool->mutex);
+    return false;
+  }
+
+  pool->workers = malloc(num_workers * sizeof(struct worker));
+  if (pool->workers == NULL)
+  {
+    worker_pool_stop(pool);
+    return false;
+  }
+
+  for (uint32_t i = 0; i < num_workers; i++)
+  {
+    pool->workers[i].pool = pool;
+    pool->workers[i].index = i;
+    if (thrd_create(&pool->workers[i].thread, worker_entry_point, &pool->workers[i]) != thrd_success)
+    {
+      break;
+    }
+    pool->num_workers++;
+  }
+
+  if (pool->num_workers == 0)
+  {
+    worker_pool_stop(pool);
+    return false;
+  }
+  return true;
+}
+
+void worker_pool_run(struct worker_pool *pool, worker_job job, void *data)
+{
+  mtx_lock(&pool->mutex);
+  while (pool->busy_workers > 0)
+  {
+    cnd_wait(&pool->job_done, &pool->mutex);
+  }
+
+  pool->job = job;
+  pool->job_done_callback = NULL;
+  pool->job_data = data;
+  pool->busy_workers = pool->num_workers;
+  pool->generation++;
+  cnd_broadcast(&pool->job_ready);
+
+  while (pool->busy_workers > 0)
+  {
+    cnd_wait(&pool->job_done, &pool->mutex);
+  }
+  mtx_unlock(&pool->mutex);
+}
+
+bool worker_pool_submit(struct worker_pool *pool, worker_job job, void *data, worker_job_done done)
+{
+  mtx_lock(&pool->mutex);
+  if (pool->busy_workers > 0)
+  {
+    mtx_unlock(&pool->mutex);
+    return false;
+  }
+
+  pool->job = job;
+  pool->job_done_callback = done;
+  pool->job_data = data;
+  pool->busy_workers = pool->num_workers;
+  pool->generation++;
+  cnd_broadcast(&pool->job_ready);
+  mtx_unlock(&pool->mutex);
+  return true;
+}
+
+bool worker_pool_busy(struct worker_pool *pool)
+{
+  mtx_lock(&pool->mutex);
+  bool busy = pool->busy_workers > 0;
+  mtx_unlock(&pool->mutex);
+  return busy;
+}
+
+void worker_pool_wait(struct worker_pool *pool)
+{
+  mtx_lock(&pool->mutex);
+  while (pool->busy_workers > 0)
+  {
+    cnd_wait(&pool->job_done, &pool->mutex);
+  }
+  mtx_unlock(&pool->mutex);
+}
+
+void worker_pool_stop(struct worker_pool *pool)
+{
+  mtx_lock(&pool->mutex);
+  pool->stopping = true;
+  cnd_broadcast(&pool->job_ready);
+  mtx_unlock(&pool->mutex);
+
+  for (uint32_t i = 0; i < pool->num_workers; i++)
+  {
+    thrd_join(pool->workers[i].thread, NULL);
+  }
+
+  free(pool->workers);
+  pool->workers = NULL;
+  pool->num_workers = 0;
+
+  cnd_destroy(&pool->job_done);
+  cnd_destroy(&pool->job_ready);
+  mtx_destroy(&pool->mutex);
+}
+
+int worker_entry_point(void *arg)
+{
+  struct worker *worker = arg;
+  struct worker_pool *pool = worker->pool;
+
+  // Workers are created before the first job is handed out, so starting from zero never misses one.
+  uint64_t seen_generation = 0;
+
+  mtx_lock(&pool->mutex);
+  for (;;)
+  {
+    while (!pool->stopping && pool->generation == seen_generation)
+    {
+      cnd_wait(&pool->job_ready, &pool->mutex);
+    }
+    if (pool->stopping)
+    {
+      break;
+    }
+
+    seen_generation = pool->generation;
+    worker_job job = pool->job;
+    worker_job_done done = pool->job_done_callback;
+    void *data = pool->job_data;
+    mtx_unlock(&pool->mutex);
+
+    job(data, worker->index);
+
+    mtx_lock(&pool->mutex);
+    if (pool->busy_workers == 1 && done != NULL)
+    {
+      // Still counted as busy so nothing new is submitted before the job is wrapped up
+      mtx_unlock(&pool->mutex);
+      done(data);
+      mtx_lock(&pool->mutex);
+    }
+    if (--pool->busy_workers == 0)
+    {
+      cnd_broadcast(&pool->job_done);
+    }
+  }
+  mtx_unlock(&pool->mutex);
+
+  return 0;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <threads.h>
+
+typedef void(*worker_job)(void *data, uint32_t worker_index);
+
+// Called by the last worker to finish a submitted job, outside of the pool's lock.
+typedef void(*worker_job_done)(void *data);
+
+struct worker_pool;
+
+struct worker
+{
+    struct worker_pool *pool;
+    uint32_t index;
+    thrd_t thread;
+};
+
+struct worker_pool
+{
+    mtx_t mutex;
+    cnd_t job_ready;
+    cnd_t job_done;
+    uint32_t num_workers;
+    struct worker *workers;
+    // Incremented each time a job is handed out, workers sleep until it moves.
+    uint64_t generation;
+    uint32_t busy_workers;
+    worker_job job;
+    worker_job_done job_done_callback;
+    void *job_data;
+    bool stopping;
+};
+
+bool worker_pool_start(struct worker_pool *pool, uint32_t num_workers);
+
+void worker_pool_run(struct worker_pool *pool, worker_job job, void *data);
+
+bool worker_pool_submit(struct worker_pool *pool, worker_job job, void *data, worker_job_done done);
+
+bool worker_pool_busy(struct worker_pool *pool);
+
+void worker_pool_wait(struct worker_pool *pool);
+
+void worker_pool_stop(struct worker_pool *pool);
+
+int worker_entry_point(void *arg);
@@ -1,16 +1,19 @@
-import 'dart:async';
 import 'dart:ffi';
+import 'dart:io';
 import 'dart:math';
 import 'dart:typed_data';
 import 'dart:ui' as ui;
 
+import 'package:c_layer/c_layer_bindings_generated.dart' show draw_status, entity_kind, frame_cache_settings, frame_stats, frame_stats_history, geometry_frame, render_mode, rgba, worker_placement, worker_policy;
 import 'package:event/event.dart';
+import 'package:ffi/ffi.dart';
 import 'package:flow/bindings.dart';
 import 'package:flow/calculations.dart';
 
 // import 'dart:developer' as dev;
 
 import 'package:flow/types.dart';
+import 'package:flow/ui_constants.dart';
 import 'package:shared_preferences/shared_preferences.dart';
 
 /// The [AppState] handles the game objects ([Player], [Target], [Enemy], [Block], [BouncingBlock], [Laser])
@@ -30,42 +33,216 @@ class AppState {
   /// Calls switch the [LengthyProcess] to [LengthyProcess.ongoing] and [_handleNewFrame] will switch it to [LengthyProcess.failed] and [LengthyProcess.done] based on the validity of the [FrameEvent].
   static LengthyProcess imageUpdateStatus = LengthyProcess.unknown;
 
+  /// The number of c_layer render workers, 0 lets the c_layer use one per available core.
+  static const int backgroundThreads = 0;
+
+  /// When true the c_layer renders the next background while the current one is displayed.
+  ///
+  /// Each call to [updateBackground] then hands over the latest finished frame, if any, instead of waiting for a new one.
+  static const bool asyncBackground = true;
+
+  /// When true the c_layer only rewrites the pixels that changed since a buffer was last rendered.
+  static const bool incrementalBackground = true;
+
+  /// When true the background is rendered with as many pixels as the screen has, rather than one per logical pixel.
+  static const bool deviceResolutionBackground = false;
+
+  /// The time in milliseconds the c_layer may spend rendering a background before lowering its render scale, 0 keeps full scale.
+  static const double backgroundFrameBudget = 8;
+
+  /// When true each c_layer render worker stays on a CPU of its own, away from the one running the UI thread.
+  static const bool pinBackgroundWorkers = false;
+
+  /// When true the c_layer keeps the background frames it rendered and shows them again instead of rendering them.
+  ///
+  /// The animation then moves in steps of [backgroundTimeQuantum] ticks and loops every [backgroundCyclePeriod] ticks,
+  /// so it is made of a fixed set of frames that are rendered ahead while the player is not playing.
+  static const bool cacheBackgroundFrames = false;
+
+  /// The memory in bytes the cached background frames may take.
+  static const int backgroundCacheBytes = 256 << 20;
+
+  /// The number of ticks the background shows the same frame for when [cacheBackgroundFrames] is true.
+  static const int backgroundTimeQuantum = 4;
+
+  /// The number of ticks after which the background animation starts over when [cacheBackgroundFrames] is true.
+  static const int backgroundCyclePeriod = 256;
+
+  /// When true the c_layer hands the background over as triangles drawn by [Space] rather than as pixels.
+  static const bool geometryBackground = false;
+
+  /// When true the c_layer workers draw the game objects into the background frames, and [Space] only draws the text over them.
+  ///
+  /// Frames with game objects are never cached, and the objects are not drawn while [geometryBackground] is true.
+  static const bool compositeEntities = false;
+
+  /// The number of background pixels per logical pixel, used to paint frames at their logical size.
+  static double _backgroundPixelRatio = 1;
+
+  /// The id of the newest frame turned into the [painting], frames that finish decoding after a newer one are dropped.
+  static int _paintedFrameId = 0;
+
+  /// The changes to the background since the last frame, handed to the c_layer in one call by [_submitCommands].
+  static final CommandEncoder _commands = CommandEncoder();
+
+  /// When true [Space] draws the timings of the latest background frames over the game.
+  static bool showFrameStats = false;
+
+  /// The timings of the latest background frames, oldest first, refreshed by [readFrameStats].
+  static List<FrameTiming> frameTimings = <FrameTiming>[];
+
+  /// The native buffer the c_layer copies its frame stats into.
+  static final Pointer<frame_stats> _frameStats = calloc<frame_stats>(frame_stats_history);
+
+  /// When true the c_layer records a trace of its threads, and the game tick and frame decoding are recorded alongside them.
+  static bool tracing = false;
+
+  /// The names of the events recorded from dart, kept allocated since the c_layer only holds on to the pointers.
+  static final Pointer<Char> traceTick = 'tick'.toNativeUtf8().cast<Char>();
+  static final Pointer<Char> _traceCopyFrame = 'copy_frame'.toNativeUtf8().cast<Char>();
+  static final Pointer<Char> _traceDecodeFrame = 'decode_frame'.toNativeUtf8().cast<Char>();
+
   /// Initializes the c_layer with the screen size.
   ///
-  /// If the screen is too big will default to 3500x2000.
+  /// The c_layer allocates its buffers on the first frame and grows them when the screen gets bigger.
   static void initialize() {
     ui.Size size = ui.PlatformDispatcher.instance.views.first.physicalSize;
     double pixelRatio = ui.PlatformDispatcher.instance.views.first.devicePixelRatio;
 
-    int maxWidth = max((size.width / pixelRatio).ceil(), 3500);
-    int maxHeight = max((size.height / pixelRatio).ceil(), 2000);
+    int width = (size.width / pixelRatio).ceil();
+    int height = (size.height / pixelRatio).ceil();
+
+    cLayerBindings.initialize(Pointer.fromFunction<FuncPtrNewFrame>(_onNewFrame), width, height, backgroundThreads);
+    cLayerBindings.set_render_mode(asyncBackground ? render_mode.render_async : render_mode.render_sync);
+    cLayerBindings.set_incremental_rendering(incrementalBackground ? 1 : 0);
+
+    _backgroundPixelRatio = deviceResolutionBackground ? pixelRatio : 1;
+    cLayerBindings.set_device_pixel_ratio(_backgroundPixelRatio);
+    cLayerBindings.set_frame_budget(backgroundFrameBudget);
+
+    if (pinBackgroundWorkers) {
+      Pointer<worker_placement> placement = calloc<worker_placement>();
+      placement.ref.pin = true;
+      placement.ref.reserve_caller_cpu = true;
+      placement.ref.policy = worker_policy.worker_policy_default;
+      cLayerBindings.set_worker_placement(placement);
+      calloc.free(placement);
+    }
+
+    if (cacheBackgroundFrames) {
+      Pointer<frame_cache_settings> settings = calloc<frame_cache_settings>();
+      settings.ref.budget_bytes = backgroundCacheBytes;
+      settings.ref.time_quantum = backgroundTimeQuantum;
+      settings.ref.cycle_period = backgroundCyclePeriod;
+      cLayerBindings.set_frame_cache(settings);
+      calloc.free(settings);
+    }
+
+    if (geometryBackground) {
+      cLayerBindings.set_geometry_output(Pointer.fromFunction<FuncPtrNewGeometry>(_onNewGeometry));
+    }
+  }
 
-    cLayerBindings.initialize(Pointer.fromFunction<FuncPtrNewFrame>(_onNewFrame), maxWidth, maxHeight);
+  /// Stops the c_layer render workers and releases the background buffer.
+  static void shutdown() {
+    cLayerBindings.shutdown();
   }
 
   /// When the user resizes the screen, conveys the change to the c_layer.
   static void updateBackgroundSize(int width, int height, int gameTime, int xOffset, int yOffset) {
-    cLayerBindings.update_background_size(width, height, gameTime, xOffset, yOffset);
+    _commands.size(width, height);
+    _commands.draw(gameTime, xOffset, yOffset);
+    _submitCommands();
+    // Frames cached at the previous size are never shown again
+    if (!player.alive) {
+      _warmBackground(xOffset, yOffset);
+    }
   }
 
-  /// Notifies the c_layer that the user wants to change the [BackgroundConfiguration].
+  /// Has the c_layer render every frame of the background animation ahead, while drawing it needs little else.
+  static void _warmBackground(int xOffset, int yOffset) {
+    if (cacheBackgroundFrames) {
+      cLayerBindings.warm_frame_cache(0, backgroundCyclePeriod ~/ backgroundTimeQuantum, xOffset, yOffset);
+    }
+  }
+
+  /// Notifies the c_layer that the user wants to change the [BackgroundConfiguration], along with the next frame.
   static void changeBackgroundConfiguration(BackgroundConfiguration configuration) {
-    cLayerBindings.update_background_config(configuration.index);
+    _commands.config(configuration.index);
   }
 
-  /// When the user adjusts the colors of the game, conveys the change to the c_layer.
+  /// When the user adjusts the colors of the game, conveys the change to the c_layer along with the next frame.
   static void updateBackgroundColor(int increment) {
-    cLayerBindings.update_background_color(increment);
+    _commands.color(increment);
+  }
+
+  /// Hands every command encoded since the last call to the c_layer, which applies them together before rendering once.
+  static int _submitCommands() {
+    int status = cLayerBindings.submit_commands(_commands.buffer, _commands.length);
+    _commands.clear();
+    return status;
+  }
+
+  /// Starts recording a trace, or stops it and writes what was recorded to a Chrome trace file in the temporary directory.
+  static void toggleTracing() {
+    tracing = !tracing;
+    if (tracing) {
+      cLayerBindings.set_tracing(1);
+      return;
+    }
+    cLayerBindings.set_tracing(0);
+    Pointer<Utf8> path = '${Directory.systemTemp.path}${Platform.pathSeparator}flow_trace.json'.toNativeUtf8();
+    cLayerBindings.write_trace(path.cast<Char>());
+    calloc.free(path);
+  }
+
+  /// The start of an event recorded with [traceEnd], 0 when not [tracing].
+  static int traceBegin() {
+    return tracing ? cLayerBindings.trace_clock() : 0;
+  }
+
+  /// Records the event [name] started at [start] in the c_layer's trace.
+  static void traceEnd(Pointer<Char> name, int start) {
+    if (start != 0) {
+      cLayerBindings.trace_dart_event(name, start, cLayerBindings.trace_clock());
+    }
+  }
+
+  /// Copies the stats of the latest frames presented by the c_layer into [frameTimings].
+  static void readFrameStats() {
+    int count = cLayerBindings.get_frame_stats(_frameStats, frame_stats_history);
+    frameTimings = List.generate(count, (index) {
+      frame_stats stats = _frameStats[index];
+      int renderEnd = stats.render_started_nanoseconds;
+      int slowestWorker = 0;
+      for (int worker = 0; worker < stats.num_workers; worker++) {
+        renderEnd = max(renderEnd, stats.workers[worker].end_nanoseconds);
+        slowestWorker = max(slowestWorker, stats.workers[worker].end_nanoseconds - stats.workers[worker].start_nanoseconds);
+      }
+      return FrameTiming(
+        stats.frame_id,
+        (stats.presented_nanoseconds - stats.requested_nanoseconds) / 1e6,
+        (renderEnd - stats.render_started_nanoseconds) / 1e6,
+        stats.wait_nanoseconds / 1e6,
+        stats.callback_nanoseconds / 1e6,
+        slowestWorker / 1e6,
+        stats.bytes_written,
+        stats.dropped_frames,
+        stats.cached,
+      );
+    }, growable: false);
   }
 
   /// Receives frame_callback from the c_layer and converts it to a [FrameEvent] on the dart side.
-  static void _onNewFrame(int width, int height, int dataSize, Pointer<Void> data) {
-    FrameEvent frameEvent = FrameEvent(width, height, data, dataSize);
+  static void _onNewFrame(int id, int width, int height, int rowBytes, int dataSize, Pointer<Void> data) {
+    FrameEvent frameEvent = FrameEvent(id, width, height, rowBytes, data, dataSize);
     _handleNewFrame(frameEvent);
   }
 
   /// Handles a [FrameEvent] and if valid will convert the buffer into a [Painting] that can be shown on a flutter canvas.
   ///
+  /// The c_layer buffer is released as soon as the engine holds its own copy of the pixels and the previous [ui.Image] is disposed once replaced.
+  ///
   /// If successful broadcast an [Event] to listening widgets.
   static Future<void> _handleNewFrame(FrameEvent? frame) async {
     if (frame == null) {
@@ -73,21 +250,81 @@ class AppState {
       return;
     }
 
-    Uint8List dataAsList = frame.data.cast<Uint8>().asTypedList(frame.dataSize);
+    int traceStart = traceBegin();
+    ui.ImmutableBuffer buffer;
+    try {
+      Uint8List dataAsList = frame.data.cast<Uint8>().asTypedList(frame.dataSize);
+      buffer = await ui.ImmutableBuffer.fromUint8List(dataAsList);
+    } finally {
+      cLayerBindings.release_frame(frame.id);
+    }
+    traceEnd(_traceCopyFrame, traceStart);
+
+    ui.ImageDescriptor descriptor = ui.ImageDescriptor.raw(
+      buffer,
+      width: frame.width,
+      height: frame.height,
+      rowBytes: frame.rowBytes,
+      pixelFormat: ui.PixelFormat.rgba8888,
+    );
+    traceStart = traceBegin();
+    ui.Codec codec = await descriptor.instantiateCodec();
+    ui.FrameInfo frameInfo = await codec.getNextFrame();
+    traceEnd(_traceDecodeFrame, traceStart);
+    codec.dispose();
+    descriptor.dispose();
+    buffer.dispose();
+
+    if (frame.id < _paintedFrameId) {
+      frameInfo.image.dispose();
+      return;
+    }
+    _paintedFrameId = frame.id;
+
+    ui.Image? previousImage = painting.image;
+    painting.image = frameInfo.image;
+    painting.height = frame.height / _backgroundPixelRatio;
+    painting.width = frame.width / _backgroundPixelRatio;
+    previousImage?.dispose();
+    painting.vertices?.dispose();
+    painting.vertices = null;
+    onNewImage.broadcast();
 
-    Completer completer = Completer();
-    ui.decodeImageFromPixels(dataAsList, frame.width, frame.height, ui.PixelFormat.rgba8888, (ui.Image result) {
-      completer.complete(result);
-    });
+    imageUpdateStatus = LengthyProcess.done;
+  }
 
-    painting.image = await completer.future;
-    painting.height = frame.height.toDouble();
-    painting.width = frame.width.toDouble();
+  /// Receives geometry_callback from the c_layer and turns the triangles into the [Painting].
+  ///
+  /// The engine copies the vertices when they are created, so the c_layer frame is released right away.
+  static void _onNewGeometry(int id, Pointer<geometry_frame> frame) {
+    geometry_frame geometry = frame.ref;
+    ui.Vertices vertices = ui.Vertices.raw(ui.VertexMode.triangles, geometry.vertices.asTypedList(geometry.num_vertices * 2));
+    ui.Color backgroundColor = _opaqueColor(geometry.background_color);
+    ui.Color lineColor = _opaqueColor(geometry.line_color);
+    int width = geometry.width;
+    int height = geometry.height;
+    cLayerBindings.release_frame(id);
+
+    _paintedFrameId = id;
+    painting.vertices?.dispose();
+    painting.vertices = vertices;
+    painting.verticesPixelRatio = _backgroundPixelRatio;
+    painting.backgroundPaint.color = backgroundColor;
+    painting.linePaint.color = lineColor;
+    painting.height = height / _backgroundPixelRatio;
+    painting.width = width / _backgroundPixelRatio;
+    painting.image?.dispose();
+    painting.image = null;
     onNewImage.broadcast();
 
     imageUpdateStatus = LengthyProcess.done;
   }
 
+  /// The c_layer leaves the alpha of its colors at 0, the background is always drawn opaque.
+  static ui.Color _opaqueColor(rgba color) {
+    return ui.Color.fromARGB(255, color.r, color.g, color.b);
+  }
+
   // --------------------------------------- SAVED OBJECTS --------------------------------------- //
   /// Used to store the user's [List] of [HighScore].
   static SharedPreferences? _preferences;
@@ -270,6 +507,10 @@ class AppState {
   /// The [Player] will be created at [pointerPosition].
   static void initializeGameState(ui.Offset pointerPosition) {
     gameTime = DateTime.now().millisecondsSinceEpoch;
+    // Whatever is not warmed yet is rendered when it is first shown, the workers are left to the game
+    if (cacheBackgroundFrames) {
+      cLayerBindings.warm_frame_cache(0, 0, 0, 0);
+    }
 
     player.initializePosition(pointerPosition);
 
@@ -279,11 +520,78 @@ class AppState {
   }
 
   /// Asks the c_layer to update the background of the game based on the game [time].
+  ///
+  /// Every change made since the previous frame and the game objects go along with the request, in a single call.
+  /// Requests are never held back, the c_layer always renders from the latest one and gives up on frames it superseded.
+  /// When the background would come out unchanged nothing is rendered, and the image on screen stays as it is.
   static void updateBackground(int time, int xOffset, int yOffset) {
-    if (AppState.imageUpdateStatus != LengthyProcess.ongoing) {
-      AppState.imageUpdateStatus = LengthyProcess.ongoing;
-      cLayerBindings.draw_background(time, xOffset, yOffset);
+    final LengthyProcess previousStatus = imageUpdateStatus;
+    imageUpdateStatus = LengthyProcess.ongoing;
+    _encodeEntities();
+    _commands.draw(time, xOffset, yOffset);
+    int status = _submitCommands();
+    if (status == draw_status.draw_unchanged) {
+      imageUpdateStatus = previousStatus;
+    } else if (status == draw_status.draw_rejected) {
+      imageUpdateStatus = LengthyProcess.failed;
+    }
+  }
+
+  /// Encodes the game objects for the c_layer to draw into the following backgrounds, when [compositeEntities] is true.
+  ///
+  /// They are described as they would be drawn by [Space], the c_layer keeps the frame unchanged when they are.
+  static void _encodeEntities() {
+    if (!compositeEntities || geometryBackground) {
+      return;
+    }
+    _commands.entities();
+    if (!player.alive) {
+      return;
+    }
+    _addCircle(player.centerPosition, player.hitBoxRadius, UIConstants.playerPaint.color);
+    _addArrow(player.centerPosition, player.hitBoxRadius, player.angle, UIConstants.playerArrowPaint.color);
+    for (Target target in targets) {
+      _addCircle(target.centerPosition, target.hitBoxRadius, UIConstants.targetPaint.color);
+      double half = target.hitBoxRadius * 0.75 / 2;
+      _addRect(target.centerPosition - ui.Offset(half, half), target.centerPosition + ui.Offset(half, half), 0, UIConstants.targetCorePaint.color);
+    }
+    for (Enemy enemy in enemies) {
+      _addCircle(enemy.centerPosition, enemy.hitBoxRadius, UIConstants.enemyPaint.color);
+      _addArrow(enemy.centerPosition, enemy.hitBoxRadius, enemy.angle, UIConstants.enemyArrowPaint.color);
     }
+    for (Block block in blocks) {
+      ui.Offset end = block.position + ui.Offset(block.width, block.height);
+      ui.Paint border = block is BouncingBlock ? UIConstants.bouncingBlockBorderPaint : UIConstants.blockBorderPaint;
+      _addRect(block.position, end, 0, UIConstants.blockPaint.color);
+      _addRect(block.position, end, border.strokeWidth, border.color);
+    }
+    for (Laser laser in lasers) {
+      _addEntity(entity_kind.entity_line, UIConstants.laserPaint.color, [laser.startPosition, laser.endPosition], laser.thickness);
+    }
+  }
+
+  static void _addCircle(ui.Offset center, double radius, ui.Color color) {
+    _addEntity(entity_kind.entity_circle, color, [center], radius);
+  }
+
+  static void _addRect(ui.Offset start, ui.Offset end, double border, ui.Color color) {
+    _addEntity(entity_kind.entity_rect, color, [start, end], border);
+  }
+
+  /// The arrow [Space] draws over a moving object pointing along its [angle].
+  static void _addArrow(ui.Offset center, double radius, double angle, ui.Color color) {
+    _addEntity(entity_kind.entity_triangle, color, [
+      center + ui.Offset(radius * cos(angle), radius * sin(angle)),
+      center + ui.Offset(radius * 0.9 * cos(angle + 15), radius * 0.9 * sin(angle + 15)),
+      center + ui.Offset(radius * 0.9 * cos(angle - 15), radius * 0.9 * sin(angle - 15)),
+    ], 0);
+  }
+
+  /// Adds an entity to the list [_encodeEntities] started, [points] beyond those the [kind] uses are left out.
+  static void _addEntity(int kind, ui.Color color, List<ui.Offset> points, double width) {
+    ui.Offset second = points.length > 1 ? points[1] : ui.Offset.zero;
+    ui.Offset third = points.length > 2 ? points[2] : ui.Offset.zero;
+    _commands.entity(kind, color.red, color.green, color.blue, color.alpha, points[0].dx, points[0].dy, second.dx, second.dy, third.dx, third.dy, width);
   }
 
   /// Update the state of the [Player], all [Target], all [Enemy] and all [Laser] existing.
@@ -403,6 +711,7 @@ class AppState {
     _addHighScore(player.points, gameTime);
 
     player.death();
+    _warmBackground(0, 0);
     for (int targetIndex = 0; targetIndex < targets.length; targetIndex++) {
       targets[targetIndex] = Target(ui.Offset.zero, 0, 0);
     }
@@ -20,4 +20,6 @@ final DynamicLibrary _dynamicLibrary = () {
 
 final CLayerBindings cLayerBindings = CLayerBindings(_dynamicLibrary);
 
-typedef FuncPtrNewFrame = Void Function(Uint64, Uint64, Uint64, Pointer<Void>);
+typedef FuncPtrNewFrame = Void Function(Uint64, Uint64, Uint64, Uint64, Uint64, Pointer<Void>);
+
+typedef FuncPtrNewGeometry = Void Function(Uint64, Pointer<geometry_frame>);
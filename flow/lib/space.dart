@@ -3,6 +3,7 @@ import 'dart:io';
 import 'dart:math';
 import 'dart:ui';
 
+import 'package:c_layer/c_layer_bindings_generated.dart' show frame_stats_history;
 import 'package:event/event.dart';
 import 'package:flow/app_state.dart';
 import 'package:flow/calculations.dart';
@@ -38,7 +39,7 @@ class _SpaceState extends State<Space> {
   Size _spaceSize = Size.zero;
   Size get spaceSize => _spaceSize;
   set spaceSize(Size size) {
-    if (AppState.imageUpdateStatus != LengthyProcess.ongoing && (size.width != _spaceSize.width || size.height != _spaceSize.height)) {
+    if (size.width != _spaceSize.width || size.height != _spaceSize.height) {
       _spaceSize = size;
       AppState.imageUpdateStatus = LengthyProcess.ongoing;
       AppState.updateBackgroundSize(size.width.ceil() + margin, size.height.ceil() + margin, timer.tick, x.floor(), x.floor());
@@ -56,6 +57,11 @@ class _SpaceState extends State<Space> {
               AppState.changeBackgroundConfiguration(BackgroundConfiguration.grid);
             } else if (event.logicalKey == LogicalKeyboardKey.digit2) {
               AppState.changeBackgroundConfiguration(BackgroundConfiguration.wave);
+            } else if (event.logicalKey == LogicalKeyboardKey.f3) {
+              AppState.showFrameStats = !AppState.showFrameStats;
+              setState(() {});
+            } else if (event.logicalKey == LogicalKeyboardKey.f4) {
+              AppState.toggleTracing();
             }
           }
         },
@@ -144,12 +150,18 @@ class _SpaceState extends State<Space> {
     super.initState();
 
     timer = Timer.periodic(const Duration(milliseconds: AppState.updateRate), (Timer t) {
+      int traceStart = AppState.traceBegin();
       AppState.updateBackground(timer.tick, 0, 0);
       if (AppState.player.alive) {
         AppState.updateGameState();
         AppState.player.updatePositionAndSpeed(hoverPosition, AppState.bounds, AppState.blocks);
         setState(() {});
       }
+      if (AppState.showFrameStats) {
+        AppState.readFrameStats();
+        setState(() {});
+      }
+      AppState.traceEnd(AppState.traceTick, traceStart);
     });
 
     AppState.onNewImage.subscribe(invokeSetState);
@@ -203,14 +215,20 @@ class SpaceObject extends RenderBox {
   @override
   void paint(PaintingContext context, Offset offset) {
     context.canvas.save();
-    if (AppState.painting.image != null) {
-      paintImage(
-        canvas: context.canvas,
-        rect: Rect.fromLTWH(0, 0, AppState.painting.width!, AppState.painting.height!),
-        image: AppState.painting.image!,
-      );
+    if (AppState.painting.ready) {
+      if (AppState.painting.vertices != null) {
+        paintGeometry(context.canvas);
+      } else {
+        paintImage(
+          canvas: context.canvas,
+          rect: Rect.fromLTWH(0, 0, AppState.painting.width!, AppState.painting.height!),
+          image: AppState.painting.image!,
+          fit: BoxFit.fill,
+        );
+      }
 
-      if (AppState.player.alive) {
+      // The c_layer already drew the game objects into the background
+      if (AppState.player.alive && (!AppState.compositeEntities || AppState.geometryBackground)) {
         // Draw player
         context.canvas.drawCircle(AppState.player.centerPosition, AppState.player.hitBoxRadius, UIConstants.playerPaint);
         context.canvas.drawVertices(
@@ -399,6 +417,59 @@ class SpaceObject extends RenderBox {
       }
     }
 
+    if (AppState.showFrameStats) {
+      paintFrameStats(context.canvas);
+    }
+
     context.canvas.restore();
   }
+
+  /// Draws the background from the triangles of the latest geometry frame, at its logical size.
+  void paintGeometry(Canvas canvas) {
+    Painting painting = AppState.painting;
+    canvas.drawRect(Rect.fromLTWH(0, 0, painting.width!, painting.height!), painting.backgroundPaint);
+    canvas.save();
+    canvas.scale(1 / painting.verticesPixelRatio);
+    canvas.drawVertices(painting.vertices!, BlendMode.srcOver, painting.linePaint);
+    canvas.restore();
+  }
+
+  /// Draws the render time of the latest background frames as bars against the frame budget, and the details of the last one.
+  void paintFrameStats(Canvas canvas) {
+    if (AppState.frameTimings.isEmpty) {
+      return;
+    }
+
+    const double barWidth = UIConstants.statsBarWidth;
+    const double graphHeight = UIConstants.statsGraphHeight;
+    double budget = AppState.backgroundFrameBudget > 0 ? AppState.backgroundFrameBudget : 16;
+    Offset origin = const Offset(UIConstants.textHorizontalMargin, UIConstants.textVerticalMargin);
+
+    canvas.drawRect(origin & Size(barWidth * frame_stats_history, graphHeight), UIConstants.statsBackgroundPaint);
+    for (int index = 0; index < AppState.frameTimings.length; index++) {
+      FrameTiming timing = AppState.frameTimings[index];
+      // Twice the budget fills the graph, a frame over budget stands out in another color
+      double barHeight = min(timing.render / (budget * 2), 1) * graphHeight;
+      canvas.drawRect(
+        Rect.fromLTWH(origin.dx + index * barWidth, origin.dy + graphHeight - barHeight, barWidth - 1, barHeight),
+        timing.render > budget || timing.droppedFrames > 0 ? UIConstants.statsSlowBarPaint : UIConstants.statsBarPaint,
+      );
+    }
+    canvas.drawLine(origin + const Offset(0, graphHeight / 2), origin + const Offset(barWidth * frame_stats_history, graphHeight / 2), UIConstants.statsBudgetPaint);
+
+    FrameTiming last = AppState.frameTimings.last;
+    TextPainter statsPainter = TextPainter(
+      text: TextSpan(
+        text: 'frame ${last.id}  render ${last.render.toStringAsFixed(2)} ms  slowest worker ${last.slowestWorker.toStringAsFixed(2)} ms\n'
+            'wait ${last.wait.toStringAsFixed(2)} ms  callback ${last.callback.toStringAsFixed(2)} ms  latency ${last.latency.toStringAsFixed(2)} ms\n'
+            'written ${(last.bytesWritten / 1024).toStringAsFixed(0)} KB  dropped ${AppState.frameTimings.fold(0, (int dropped, timing) => dropped + timing.droppedFrames)}  '
+            'cached ${AppState.frameTimings.where((timing) => timing.cached).length}',
+        style: UIConstants.statsStyle,
+      ),
+      textAlign: TextAlign.start,
+      textDirection: TextDirection.ltr,
+    );
+    statsPainter.layout();
+    statsPainter.paint(canvas, origin + const Offset(0, graphHeight + 4));
+  }
 }
@@ -1,9 +1,12 @@
 import 'dart:convert';
 import 'dart:ffi';
 import 'dart:math';
+import 'dart:typed_data';
 import 'dart:ui';
 
+import 'package:c_layer/c_layer_bindings_generated.dart' show command_opcode, command_stream_version;
 import 'package:event/event.dart';
+import 'package:ffi/ffi.dart';
 import 'package:flow/calculations.dart';
 
 /// A class representing a [Painting] to be displayed on the screen.
@@ -18,6 +21,21 @@ class Painting {
 
   /// The image of the [Painting].
   Image? image;
+
+  /// The line colored areas of the [Painting] as triangles, set instead of [image] when the c_layer hands out geometry.
+  Vertices? vertices;
+
+  /// The number of [vertices] units per logical pixel.
+  double verticesPixelRatio = 1;
+
+  /// The [Paint] filling the [Painting] under its [vertices].
+  Paint backgroundPaint = Paint();
+
+  /// The [Paint] the [vertices] are drawn with.
+  Paint linePaint = Paint();
+
+  /// True once a frame of either kind has been received.
+  bool get ready => image != null || vertices != null;
 }
 
 /// A class representing a [FrameEvent] sent from the c_layer to the dart side.
@@ -25,13 +43,21 @@ class Painting {
 /// Each frame is an array of unsigned bytes called [data] of length [dataSize].
 ///
 /// Each frame represents an image to be drawn on the screen and is therefore a screen of dimensions [width] and [height].
+///
+/// The [data] belongs to the c_layer and must be handed back with its [id] once it has been consumed.
 class FrameEvent extends EventArgs {
+  /// The [id] used to release the frame to the c_layer.
+  final int id;
+
   /// The [width] of the image.
   final int width;
 
   /// The [height] of the image.
   final int height;
 
+  /// The number of bytes between the start of two rows of [data], rows can be padded past [width] pixels.
+  final int rowBytes;
+
   /// The [length] of the [data] array.
   final int dataSize;
 
@@ -40,8 +66,168 @@ class FrameEvent extends EventArgs {
 
   /// Public constructor of [FrameEvent].
   ///
-  /// Requires three [int] for the [width], [height] and [dataSize] as well as a [Pointer] to the [data] array.
-  FrameEvent(this.width, this.height, this.data, this.dataSize);
+  /// Requires five [int] for the [id], [width], [height], [rowBytes] and [dataSize] as well as a [Pointer] to the [data] array.
+  FrameEvent(this.id, this.width, this.height, this.rowBytes, this.data, this.dataSize);
+}
+
+/// The timings of one background frame presented by the c_layer.
+///
+/// Times are in milliseconds and read from the c_layer's frame stats, see [AppState.readFrameStats].
+class FrameTiming {
+  /// The [id] the frame was handed over with.
+  final int id;
+
+  /// The time from the request of the frame until it was handed over.
+  final double latency;
+
+  /// The time from the start of the render until its last worker was done.
+  final double render;
+
+  /// The time the caller spent waiting for the workers, 0 when the c_layer renders asynchronously.
+  final double wait;
+
+  /// The time spent in the frame callback.
+  final double callback;
+
+  /// The longest time a single worker spent on the frame.
+  final double slowestWorker;
+
+  /// The number of RGBA bytes rewritten for the frame.
+  final int bytesWritten;
+
+  /// The number of frames lost since the previous frame was handed over.
+  final int droppedFrames;
+
+  /// True when the frame was copied out of the c_layer frame cache rather than rendered.
+  final bool cached;
+
+  /// Public constructor of [FrameTiming].
+  const FrameTiming(this.id, this.latency, this.render, this.wait, this.callback, this.slowestWorker, this.bytesWritten, this.droppedFrames, this.cached);
+}
+
+/// Encodes the changes to the background made during a tick into one command stream for the c_layer's submit_commands.
+///
+/// The stream is written into native memory through a [Uint8List] view, both kept and reused for every stream.
+class CommandEncoder {
+  /// The number of bytes an entity takes in the stream.
+  static const int _entitySize = 33;
+
+  /// The native memory the c_layer reads the stream from.
+  Pointer<Uint8> _buffer = nullptr;
+
+  /// The view of [_buffer] the stream is written through.
+  late ByteData _data;
+
+  /// The number of bytes written so far, the version byte included.
+  int _length = 0;
+
+  /// The position of the count of the entities command being written, -1 when there is none.
+  int _entityCountOffset = -1;
+
+  /// The number of entities written to the entities command at [_entityCountOffset].
+  int _entityCount = 0;
+
+  /// Public constructor of [CommandEncoder], the stream grows past [capacity] bytes when needed.
+  CommandEncoder([int capacity = 4096]) {
+    _grow(capacity);
+    clear();
+  }
+
+  /// The stream to hand to submit_commands along with its [length].
+  Pointer<Uint8> get buffer => _buffer;
+
+  /// The number of bytes of [buffer] that make up the stream.
+  int get length => _length;
+
+  /// Starts a new stream, dropping whatever was written.
+  void clear() {
+    _data.setUint8(0, command_stream_version);
+    _length = 1;
+    _entityCountOffset = -1;
+  }
+
+  /// Switches the background to the configuration of index [configuration].
+  void config(int configuration) {
+    _opcode(command_opcode.command_config, 1);
+    _data.setUint8(_length++, configuration);
+  }
+
+  /// Shifts the background color by [increment], as update_background_color.
+  void color(int increment) {
+    _opcode(command_opcode.command_color, 4);
+    _data.setInt32(_length, increment, Endian.little);
+    _length += 4;
+  }
+
+  /// Resizes the background to [width] by [height] logical pixels.
+  void size(int width, int height) {
+    _opcode(command_opcode.command_size, 16);
+    _data.setUint64(_length, width, Endian.little);
+    _data.setUint64(_length + 8, height, Endian.little);
+    _length += 16;
+  }
+
+  /// Starts the list of entities drawn over the background, every following [entity] is added to it.
+  ///
+  /// An empty list removes the entities drawn so far.
+  void entities() {
+    _opcode(command_opcode.command_entities, 4);
+    _entityCountOffset = _length;
+    _entityCount = 0;
+    _data.setUint32(_length, 0, Endian.little);
+    _length += 4;
+  }
+
+  /// Adds an entity of [kind] and color [r], [g], [b], [a] to the list started by [entities], see the c_layer's struct entity.
+  void entity(int kind, int r, int g, int b, int a, double x0, double y0, double x1, double y1, double x2, double y2, double width) {
+    _reserve(_entitySize);
+    _data.setUint8(_length, kind);
+    _data.setUint8(_length + 1, r);
+    _data.setUint8(_length + 2, g);
+    _data.setUint8(_length + 3, b);
+    _data.setUint8(_length + 4, a);
+    int offset = _length + 5;
+    for (double value in [x0, y0, x1, y1, x2, y2, width]) {
+      _data.setFloat32(offset, value, Endian.little);
+      offset += 4;
+    }
+    _length += _entitySize;
+    _data.setUint32(_entityCountOffset, ++_entityCount, Endian.little);
+  }
+
+  /// Asks for a frame of the background at [cycleTime] moved by [xOffset], [yOffset], as draw_background.
+  void draw(int cycleTime, int xOffset, int yOffset) {
+    _opcode(command_opcode.command_draw, 24);
+    _data.setUint64(_length, cycleTime, Endian.little);
+    _data.setInt64(_length + 8, xOffset, Endian.little);
+    _data.setInt64(_length + 16, yOffset, Endian.little);
+    _length += 24;
+  }
+
+  /// Writes the [opcode] of a command with [size] bytes of operands, entities added afterwards no longer belong to a list.
+  void _opcode(int opcode, int size) {
+    _reserve(1 + size);
+    _data.setUint8(_length++, opcode);
+    _entityCountOffset = -1;
+  }
+
+  void _reserve(int size) {
+    if (_length + size > _data.lengthInBytes) {
+      _grow(max(_data.lengthInBytes * 2, _length + size));
+    }
+  }
+
+  /// Moves the stream to native memory of [capacity] bytes, the old memory is freed.
+  void _grow(int capacity) {
+    Pointer<Uint8> buffer = calloc<Uint8>(capacity);
+    Uint8List bytes = buffer.asTypedList(capacity);
+    if (_buffer != nullptr) {
+      bytes.setRange(0, _length, _buffer.asTypedList(_length));
+      calloc.free(_buffer);
+    }
+    _buffer = buffer;
+    _data = ByteData.sublistView(bytes);
+  }
 }
 
 class HighScore {
@@ -13,6 +13,9 @@ class UIConstants {
   static const double textHorizontalMargin = 40;
   static const double textVerticalMargin = 20;
 
+  static const double statsBarWidth = 4;
+  static const double statsGraphHeight = 60;
+
   static const Color lightBlue = Color.fromARGB(255, 173, 216, 230);
   static const Color neonBlue = Color.fromARGB(255, 0, 255, 255);
   static const Color darkBlue = Color.fromARGB(255, 0, 0, 139);
@@ -63,6 +66,26 @@ class UIConstants {
     decoration: TextDecoration.none,
   );
 
+  static const TextStyle statsStyle = TextStyle(
+    fontSize: 12,
+    color: Colors.white,
+    backgroundColor: Color.fromARGB(160, 0, 0, 0),
+    decoration: TextDecoration.none,
+  );
+
+  static final Paint statsBackgroundPaint = Paint()
+    ..color = const Color.fromARGB(160, 0, 0, 0)
+    ..style = PaintingStyle.fill;
+  static final Paint statsBarPaint = Paint()
+    ..color = neonGreen
+    ..style = PaintingStyle.fill;
+  static final Paint statsSlowBarPaint = Paint()
+    ..color = Colors.red
+    ..style = PaintingStyle.fill;
+  static final Paint statsBudgetPaint = Paint()
+    ..color = neonYellow
+    ..strokeWidth = 1;
+
   static final Paint playerPaint = Paint()
     ..color = Colors.white
     ..style = PaintingStyle.fill;